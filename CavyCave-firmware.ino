@@ -21,6 +21,7 @@
 #include "Controller.hpp"
 #include "Debug.hpp"
 #include "Radio.hpp"
+#include "Scheduler.hpp"
 #include "Stats.hpp"
 
 namespace
@@ -29,7 +30,28 @@ namespace
 	Controller controller;
 	Stats stats(controller);
 	Radio radio(controller, stats);
-	Debug debug(controller, radio, stats);
+	Scheduler scheduler;
+	Debug debug(controller, radio, stats, scheduler);
+
+	void runController()
+	{
+		controller.run();
+	}
+
+	void updateController()
+	{
+		controller.update();
+	}
+
+	void updateStats()
+	{
+		stats.update();
+	}
+
+	void runRadio()
+	{
+		while (radio.run());
+	}
 
 }
 
@@ -39,13 +61,19 @@ void setup()
 	stats.begin();
 	debug.begin(57600);
 	radio.begin();
+
+	// Sensor reads poll the 1-Wire buses, the budgets leave room for that
+	scheduler.add(F("Controller run"), runController, 1, 8000);
+	scheduler.add(F("Controller update"), updateController, Controller::update_period_ms, 4000);
+	scheduler.add(F("Statistics"), updateStats, Stats::period_ms, 1000);
+	scheduler.add(F("Radio"), runRadio, 10, 3000);
 }
 
 void loop()
 {
-	controller.run();
-	stats.run();
-	while (radio.run());
+	if (!scheduler.run()) {
+		scheduler.sleep();
+	}
 }
 
 void serialEvent()
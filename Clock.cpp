@@ -0,0 +1,63 @@
+/*
+	CavyCave - A temperature controlled box for guinea pigs and other
+		small animals kept outside in winter
+
+	Copyright (C) 2020-2021 Flössie <floessie.mail@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <Arduino.h>
+
+#include "Clock.hpp"
+
+Clock::Clock() :
+	set(false),
+	sync_timestamp(0),
+	sync_seconds(0)
+{
+}
+
+void Clock::run()
+{
+	// Move the reference forward daily, so millis() - sync_timestamp
+	// never wraps
+	constexpr uint32_t day_ms = seconds_per_day * 1000UL;
+
+	if (millis() - sync_timestamp >= day_ms) {
+		sync_timestamp += day_ms;
+	}
+}
+
+bool Clock::isSet() const
+{
+	return set;
+}
+
+uint32_t Clock::getSecondsOfDay() const
+{
+	return (sync_seconds + (millis() - sync_timestamp) / 1000UL) % seconds_per_day;
+}
+
+uint16_t Clock::getMinuteOfDay() const
+{
+	return getSecondsOfDay() / 60UL;
+}
+
+void Clock::setSecondsOfDay(uint32_t value)
+{
+	set = true;
+	sync_timestamp = millis();
+	sync_seconds = value % seconds_per_day;
+}
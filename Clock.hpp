@@ -0,0 +1,46 @@
+/*
+	CavyCave - A temperature controlled box for guinea pigs and other
+		small animals kept outside in winter
+
+	Copyright (C) 2020-2021 Flössie <floessie.mail@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Time of day kept from millis(), as there is no RTC on the board. It
+// has to be set over serial or radio after every restart.
+class Clock final
+{
+public:
+	static constexpr uint32_t seconds_per_day = 24UL * 60UL * 60UL;
+
+	Clock();
+
+	void run();
+
+	bool isSet() const;
+
+	uint32_t getSecondsOfDay() const;
+	uint16_t getMinuteOfDay() const;
+	void setSecondsOfDay(uint32_t value);
+
+private:
+	bool set;
+	uint32_t sync_timestamp;
+	uint32_t sync_seconds;
+};
@@ -19,16 +19,24 @@
 */
 
 #include <EEPROM.h>
+#include <avr/wdt.h>
 
 #include "Controller.hpp"
 
+#include "Crc.hpp"
+#include "Psychrometrics.hpp"
+
 namespace
 {
 
+	constexpr uint32_t updates_per_minute = 60000UL / Controller::update_period_ms;
+
 	Fan fan;
 	Heating heating;
 	Led led;
 	Sensors sensors;
+	Clock rtc;
+	Schedule schedule;
 
 	constexpr bool timeAfter(uint32_t a, uint32_t b)
 	{
@@ -51,6 +59,770 @@ namespace
 		Serial.println(F("%"));
 	}
 
+	void printDuty(uint16_t duty_per_mill)
+	{
+		Serial.print(duty_per_mill / 10);
+		Serial.print(F("."));
+		Serial.print(duty_per_mill % 10);
+		Serial.println(F("%"));
+	}
+
+	void printBand(const Controller::Configuration::Band& band)
+	{
+		Serial.print(band.min_temperature_10th_c / 10);
+		Serial.print(F("."));
+		Serial.print(abs(band.min_temperature_10th_c) % 10);
+		Serial.print(F("°C - "));
+		printTemperature(band.max_temperature_10th_c);
+	}
+
+	void print02(uint32_t value)
+	{
+		if (value < 10) {
+			Serial.print(F("0"));
+		}
+		Serial.print(value);
+	}
+
+	void printPid(const Controller::Configuration::Pid& pid)
+	{
+		Serial.print(pid.kp);
+		Serial.print(F(", "));
+		Serial.print(pid.ki);
+		Serial.print(F(", "));
+		Serial.println(pid.kd);
+	}
+
+	struct PidState {
+		int32_t integral;
+		int16_t previous_input;
+		int32_t delta_16th;
+		bool primed;
+	};
+
+	// PID with a low pass filtered derivative on the measurement and
+	// conditional integration as anti-windup, run once per update period
+	class Pid final
+	{
+	public:
+		Pid() :
+			integral(0),
+			previous_input(0),
+			delta_16th(0),
+			primed(false)
+		{
+		}
+
+		void reset()
+		{
+			integral = 0;
+			delta_16th = 0;
+			primed = false;
+		}
+
+		PidState getState() const
+		{
+			return {integral, previous_input, delta_16th, primed};
+		}
+
+		void setState(const PidState& state)
+		{
+			integral = state.integral;
+			previous_input = state.previous_input;
+			delta_16th = state.delta_16th;
+			primed = state.primed;
+		}
+
+		// The feed-forward duty is added to the output before clamping
+		uint16_t run(const Controller::Configuration::Pid& gains, int16_t setpoint, int16_t input, int16_t feed_forward)
+		{
+			const int32_t error = constrain(static_cast<int32_t>(setpoint) - input, -1000, 1000);
+
+			if (primed) {
+				delta_16th += ((static_cast<int32_t>(input) - previous_input) * 16 - delta_16th) / 8;
+			}
+
+			previous_input = input;
+			primed = true;
+
+			// Integral is kept in 1/256 ‰ per update period
+			const int32_t integral_scale = 256L * updates_per_minute;
+
+			const int32_t p = static_cast<int32_t>(gains.kp) * error / 256;
+			const int32_t d = -(static_cast<int32_t>(gains.kd) * delta_16th / 16) * static_cast<int32_t>(updates_per_minute) / 256;
+			const int32_t next_integral = constrain(
+				integral + static_cast<int32_t>(gains.ki) * error,
+				0,
+				1000L * integral_scale
+			);
+
+			const int32_t unclamped = feed_forward + p + next_integral / integral_scale + d;
+
+			// Only integrate if that doesn't push a saturated output further
+			if (!(unclamped > 1000 && error > 0) && !(unclamped < 0 && error < 0)) {
+				integral = next_integral;
+			}
+
+			return constrain(feed_forward + p + integral / integral_scale + d, 0, 1000);
+		}
+
+	private:
+		int32_t integral;
+		int16_t previous_input;
+		int32_t delta_16th;
+		bool primed;
+	};
+
+	// First order thermal model of a zone, learning the temperature slope
+	// with the heater on (heater gain minus heat loss) and off (heat loss).
+	// Recursive least squares on the regressors [u, 1 - u] with forgetting
+	// decouples into one exponential average per regressor for an on/off
+	// heater, so that is what is computed. Only windows with the heater
+	// constantly on or off are used.
+	class ThermalModel final
+	{
+	public:
+		ThermalModel() :
+			slope_256th{},
+			samples{},
+			window_ticks(0),
+			window_on_ticks(0),
+			window_start(0)
+		{
+		}
+
+		// Called once per update period
+		void run(bool valid, int16_t input, bool heating)
+		{
+			if (!valid) {
+				window_ticks = 0;
+				return;
+			}
+
+			if (!window_ticks) {
+				window_start = input;
+				window_on_ticks = 0;
+			}
+
+			++window_ticks;
+			if (heating) {
+				++window_on_ticks;
+			}
+
+			if (window_ticks == window_minutes * updates_per_minute + 1) {
+				// The first tick of a window only provides its start value
+				const uint8_t on_ticks = window_on_ticks - (heating ? 1 : 0);
+				const uint8_t ticks = window_ticks - 1;
+
+				if (!on_ticks || on_ticks == ticks) {
+					const uint8_t i = on_ticks ? 1 : 0;
+					const int32_t slope = (static_cast<int32_t>(input) - window_start) * 256 / window_minutes;
+
+					if (!samples[i]) {
+						slope_256th[i] = slope;
+					} else {
+						slope_256th[i] += (slope - slope_256th[i]) / 16;
+					}
+
+					if (samples[i] < 255) {
+						++samples[i];
+					}
+				}
+
+				window_ticks = 0;
+				run(valid, input, heating);
+			}
+		}
+
+		bool isTrained() const
+		{
+			return samples[0] >= 8 && samples[1] >= 8;
+		}
+
+		// Slope in 1/256 of 1/10 °C per minute
+		int32_t getSlope(bool heating) const
+		{
+			return slope_256th[heating ? 1 : 0];
+		}
+
+		int16_t predict(int16_t input, bool heating, uint8_t minutes) const
+		{
+			if (!isTrained()) {
+				return input;
+			}
+
+			return constrain(input + getSlope(heating) * minutes / 256, INT16_MIN, INT16_MAX);
+		}
+
+	private:
+		static constexpr uint8_t window_minutes = 2;
+
+		int32_t slope_256th[2];
+		uint8_t samples[2];
+		uint8_t window_ticks;
+		uint8_t window_on_ticks;
+		int16_t window_start;
+	};
+
+	enum class Input : uint8_t {
+		ROOM,
+		FLOOR
+	};
+
+	// Maps each zone to the sensor input it is controlled by and to the
+	// heater output warming it
+	struct ZoneDefinition {
+		const char* name;
+		Input input;
+		uint8_t heater;
+	};
+
+	const char lounge_name[] PROGMEM = "Lounge";
+	const char vestibule_name[] PROGMEM = "Vestibule";
+
+	constexpr ZoneDefinition zone_definitions[] PROGMEM = {
+		{lounge_name, Input::ROOM, 0},
+		{vestibule_name, Input::FLOOR, 1}
+	};
+
+	static_assert(sizeof(zone_definitions) / sizeof(ZoneDefinition) == Controller::ZONE_COUNT, "Zone table incomplete");
+
+	// LINKED heats all zones together until this one is warm enough
+	constexpr uint8_t linked_lead_zone = Controller::VESTIBULE;
+
+	ZoneDefinition getZoneDefinition(uint8_t zone)
+	{
+		ZoneDefinition definition;
+		memcpy_P(&definition, zone_definitions + zone, sizeof(definition));
+		return definition;
+	}
+
+	// Control strategies are tables of rules. A rule fires when all of its
+	// "when" conditions and none of its "unless" conditions hold. Heating
+	// rules are evaluated for each zone, with the ZONE_* conditions of
+	// that zone. The actions of all firing rules are applied together.
+	enum Condition : uint16_t {
+		ZONE_VALID = 1U << 0,
+		ZONE_LOW = 1U << 1,
+		ZONE_HIGH = 1U << 2,
+		ZONE_HEATING = 1U << 3,
+		ALL_VALID = 1U << 4,
+		ANY_LOW = 1U << 5,
+		LEAD_HIGH = 1U << 6,
+		HUMIDITY_VALID = 1U << 7,
+		HUMIDITY_HIGH = 1U << 8,
+		HUMIDITY_LOW = 1U << 9,
+		FAN_RUNNING = 1U << 10,
+		FAN_PAUSED = 1U << 11,
+		DEW_POINT_FAR = 1U << 12,
+		DEW_POINT_CLEAR = 1U << 13
+	};
+
+	enum Action : uint8_t {
+		HEAT_ON = 1U << 0,
+		HEAT_OFF = 1U << 1,
+		FAN_START = 1U << 2,
+		FAN_STOP = 1U << 3
+	};
+
+	struct Rule {
+		uint16_t when;
+		uint16_t unless;
+		uint8_t actions;
+	};
+
+	struct RuleTable {
+		const Rule* rules;
+		uint8_t count;
+	};
+
+	constexpr Rule independent_rules[] PROGMEM = {
+		{ZONE_VALID | ZONE_LOW, ZONE_HEATING, HEAT_ON},
+		{ZONE_VALID | ZONE_HIGH | ZONE_HEATING, 0, HEAT_OFF}
+	};
+
+	constexpr Rule linked_rules[] PROGMEM = {
+		{ALL_VALID | ANY_LOW, ZONE_HEATING | LEAD_HIGH, HEAT_ON},
+		{ALL_VALID | LEAD_HIGH | ZONE_HEATING, 0, HEAT_OFF}
+	};
+
+	// Shared by all auto modes
+	constexpr Rule fan_rules[] PROGMEM = {
+		{HUMIDITY_VALID | HUMIDITY_HIGH, FAN_RUNNING | FAN_PAUSED | DEW_POINT_FAR, FAN_START},
+		{HUMIDITY_VALID | HUMIDITY_LOW | FAN_RUNNING, FAN_PAUSED, FAN_STOP},
+		{DEW_POINT_CLEAR | FAN_RUNNING, FAN_PAUSED, FAN_STOP}
+	};
+
+	// Keeps the fan from cycling on the dew point margin
+	constexpr int16_t dew_point_hysteresis_10th_c = 10;
+
+	// Indexed by AutoMode, PID heats continuously and has no rules
+	constexpr RuleTable auto_mode_rules[] PROGMEM = {
+		{independent_rules, sizeof(independent_rules) / sizeof(Rule)},
+		{linked_rules, sizeof(linked_rules) / sizeof(Rule)},
+		{nullptr, 0}
+	};
+
+	uint8_t evaluateRules(const Rule* rules, uint8_t count, uint16_t conditions)
+	{
+		uint8_t actions = 0;
+
+		for (uint8_t i = 0; i < count; ++i) {
+			Rule rule;
+			memcpy_P(&rule, rules + i, sizeof(rule));
+
+			if ((conditions & rule.when) == rule.when && !(conditions & rule.unless)) {
+				actions |= rule.actions;
+			}
+		}
+
+		return actions;
+	}
+
+	// Keeps the heaters within the supply's limit: turn ons are at least
+	// stagger_ms apart, and if the demand exceeds the budget, the
+	// priority zone is served first and the others take turns every
+	// slice_ms
+	class PowerLimiter final
+	{
+	public:
+		PowerLimiter() :
+			powered{},
+			turn_on_timestamp(0),
+			slice_timestamp(0),
+			slice_start(0)
+		{
+		}
+
+		void run(const Controller::Configuration& configuration, const bool (&demand)[Controller::ZONE_COUNT], Controller::Output (&output)[Controller::ZONE_COUNT])
+		{
+			if (millis() - slice_timestamp >= slice_ms) {
+				slice_timestamp = millis();
+				slice_start = (slice_start + 1) % Controller::ZONE_COUNT;
+			}
+
+			uint32_t load_watts = 0;
+
+			for (uint8_t i = 0; i <= Controller::ZONE_COUNT; ++i) {
+				// The priority zone first, then all in turn
+				const uint8_t zone =
+					i
+						? (slice_start + i - 1) % Controller::ZONE_COUNT
+						: configuration.priority_zone;
+
+				if (zone >= Controller::ZONE_COUNT || (i && zone == configuration.priority_zone)) {
+					continue;
+				}
+
+				if (!demand[zone]) {
+					powered[zone] = false;
+					output[zone] = Controller::Output::OFF;
+					continue;
+				}
+
+				if (configuration.max_load_watts && load_watts + configuration.heater_watts[zone] > configuration.max_load_watts) {
+					powered[zone] = false;
+					output[zone] = Controller::Output::SHED;
+					continue;
+				}
+
+				load_watts += configuration.heater_watts[zone];
+
+				if (!powered[zone] && millis() - turn_on_timestamp >= stagger_ms) {
+					powered[zone] = true;
+					turn_on_timestamp = millis();
+				}
+
+				output[zone] = powered[zone] ? Controller::Output::ON : Controller::Output::STAGGERED;
+			}
+		}
+
+		bool isPowered(uint8_t zone) const
+		{
+			return powered[zone];
+		}
+
+	private:
+		static constexpr uint32_t stagger_ms = 5000;
+		static constexpr uint32_t slice_ms = 2UL * 60UL * 1000UL;
+
+		bool powered[Controller::ZONE_COUNT];
+		uint32_t turn_on_timestamp;
+		uint32_t slice_timestamp;
+		uint8_t slice_start;
+	};
+
+	struct EnergyBudgetState {
+		uint8_t hour;
+		uint16_t allocated_budget_wh;
+		uint32_t last_seconds_of_day;
+		uint32_t day_start_seconds;
+		uint32_t used_ws;
+		uint32_t hour_start_used_ws;
+		uint32_t hour_allowance_ws;
+	};
+
+	// Spreads a daily energy allowance over the day. At the start of each
+	// hour it receives the share of the remaining energy that its
+	// coldness has among the remaining hours, learnt from the
+	// temperatures of past days. Within the hour, each heating cycle gets
+	// its share of what is left, capping the duty over the cycle.
+	class EnergyBudget final
+	{
+	public:
+		EnergyBudget() :
+			hourly_10th_c{},
+			hourly_known(false),
+			hour_sum_10th_c(0),
+			hour_samples(0),
+			hour(no_hour),
+			allocated_budget_wh(0),
+			last_seconds_of_day(0),
+			day_start_seconds(0),
+			used_ws(0),
+			used_watt_ms(0),
+			integrate_timestamp(0),
+			hour_start_used_ws(0),
+			hour_allowance_ws(0),
+			cycle_timestamp(0),
+			cycle_ms(0),
+			cycle_start_used_ws(0),
+			cycle_allowance_ws(0)
+		{
+		}
+
+		// Called every loop with the load currently powered
+		void integrate(uint16_t load_watts)
+		{
+			const uint32_t now = millis();
+
+			used_watt_ms += static_cast<uint32_t>(load_watts) * (now - integrate_timestamp);
+			integrate_timestamp = now;
+
+			used_ws += used_watt_ms / 1000UL;
+			used_watt_ms %= 1000UL;
+		}
+
+		// Called once per update period, the reference being the
+		// temperature heated to
+		void update(uint16_t budget_wh, uint32_t seconds_of_day, bool valid, int16_t temperature_10th_c, int16_t reference_10th_c)
+		{
+			if (seconds_of_day < last_seconds_of_day) {
+				// New day
+				learnHour();
+				used_ws = 0;
+				cycle_start_used_ws = 0;
+				hour = no_hour;
+			}
+			last_seconds_of_day = seconds_of_day;
+
+			const uint8_t current_hour = seconds_of_day / 3600UL;
+
+			if (current_hour != hour || budget_wh != allocated_budget_wh) {
+				if (hour != no_hour && current_hour != hour) {
+					learnHour();
+				}
+				if (hour == no_hour) {
+					day_start_seconds = seconds_of_day;
+				}
+
+				hour = current_hour;
+				allocated_budget_wh = budget_wh;
+				hour_start_used_ws = used_ws;
+
+				uint32_t weight_sum = 0;
+				for (uint8_t h = hour; h < 24; ++h) {
+					weight_sum += getWeight(h, reference_10th_c);
+				}
+
+				hour_allowance_ws = getRemainingWs(budget_wh) / weight_sum * getWeight(hour, reference_10th_c);
+
+				allocateCycle();
+			}
+
+			if (valid) {
+				hour_sum_10th_c += temperature_10th_c;
+				++hour_samples;
+			}
+		}
+
+		EnergyBudgetState getState() const
+		{
+			return {hour, allocated_budget_wh, last_seconds_of_day, day_start_seconds, used_ws, hour_start_used_ws, hour_allowance_ws};
+		}
+
+		void setState(const EnergyBudgetState& state)
+		{
+			hour = state.hour;
+			allocated_budget_wh = state.allocated_budget_wh;
+			last_seconds_of_day = state.last_seconds_of_day;
+			day_start_seconds = state.day_start_seconds;
+			used_ws = state.used_ws;
+			hour_start_used_ws = state.hour_start_used_ws;
+			hour_allowance_ws = state.hour_allowance_ws;
+		}
+
+		// Called at the start of each heating cycle
+		void startCycle(uint32_t _cycle_ms)
+		{
+			cycle_timestamp = millis();
+			cycle_ms = _cycle_ms;
+			cycle_start_used_ws = used_ws;
+
+			allocateCycle();
+		}
+
+		bool isAllowed(uint16_t budget_wh) const
+		{
+			if (!budget_wh) {
+				return true;
+			}
+
+			return used_ws - cycle_start_used_ws < cycle_allowance_ws;
+		}
+
+		Controller::Energy getEnergy(uint16_t budget_wh) const
+		{
+			const uint32_t elapsed_s = max(last_seconds_of_day - day_start_seconds, 1UL);
+			const uint64_t projected_ws = used_ws + static_cast<uint64_t>(used_ws) * (Clock::seconds_per_day - last_seconds_of_day) / elapsed_s;
+
+			return {
+				budget_wh,
+				static_cast<uint16_t>(used_ws / 3600UL),
+				static_cast<uint16_t>(getRemainingWs(budget_wh) / 3600UL),
+				static_cast<uint16_t>(min(projected_ws / 3600UL, 0xFFFFULL)),
+				static_cast<uint16_t>(hour_allowance_ws / 3600UL)
+			};
+		}
+
+	private:
+		static constexpr uint8_t no_hour = 0xFF;
+
+		uint32_t getRemainingWs(uint16_t budget_wh) const
+		{
+			const uint32_t budget_ws = budget_wh * 3600UL;
+
+			return budget_ws > used_ws ? budget_ws - used_ws : 0;
+		}
+
+		// What is left of the hour's allowance, spread evenly over the rest
+		// of the hour, for the rest of the cycle. Redone when the hour's
+		// allowance changes mid-cycle.
+		void allocateCycle()
+		{
+			const uint32_t hour_used_ws = used_ws - hour_start_used_ws;
+			const uint32_t hour_left_ws = hour_allowance_ws > hour_used_ws ? hour_allowance_ws - hour_used_ws : 0;
+			const uint32_t hour_left_ms = (3600UL - last_seconds_of_day % 3600UL) * 1000UL;
+			const uint32_t cycle_elapsed_ms = millis() - cycle_timestamp;
+			const uint32_t cycle_left_ms = cycle_ms > cycle_elapsed_ms ? cycle_ms - cycle_elapsed_ms : 0;
+
+			cycle_allowance_ws =
+				used_ws - cycle_start_used_ws
+				+ (
+					cycle_left_ms < hour_left_ms
+						? static_cast<uint64_t>(hour_left_ws) * cycle_left_ms / hour_left_ms
+						: hour_left_ws
+				);
+		}
+
+		uint16_t getWeight(uint8_t h, int16_t reference_10th_c) const
+		{
+			if (!hourly_known) {
+				return 1;
+			}
+
+			return constrain(static_cast<int32_t>(reference_10th_c) - hourly_10th_c[h], 1, 1000);
+		}
+
+		void learnHour()
+		{
+			if (hour == no_hour || !hour_samples) {
+				return;
+			}
+
+			const int16_t mean_10th_c = hour_sum_10th_c / hour_samples;
+
+			if (!hourly_known) {
+				for (uint8_t h = 0; h < 24; ++h) {
+					hourly_10th_c[h] = mean_10th_c;
+				}
+				hourly_known = true;
+			} else {
+				hourly_10th_c[hour] += (mean_10th_c - hourly_10th_c[hour]) / 4;
+			}
+
+			hour_sum_10th_c = 0;
+			hour_samples = 0;
+		}
+
+		int16_t hourly_10th_c[24];
+		bool hourly_known;
+		int32_t hour_sum_10th_c;
+		uint16_t hour_samples;
+		uint8_t hour;
+		uint16_t allocated_budget_wh;
+
+		uint32_t last_seconds_of_day;
+		uint32_t day_start_seconds;
+		uint32_t used_ws;
+		uint32_t used_watt_ms;
+		uint32_t integrate_timestamp;
+		uint32_t hour_start_used_ws;
+		uint32_t hour_allowance_ws;
+
+		uint32_t cycle_timestamp;
+		uint32_t cycle_ms;
+		uint32_t cycle_start_used_ws;
+		uint32_t cycle_allowance_ws;
+	};
+
+	void printSlope(int32_t slope_256th)
+	{
+		// 1/256 of 1/10 °C per minute to 1/10 °C per hour
+		printTemperature(constrain(slope_256th * 60 / 256, -INT16_MAX, INT16_MAX));
+	}
+
+	// Åström-Hägglund relay experiment: switch the heater around the
+	// setpoint and derive the gains from the resulting oscillation
+	class Autotune final
+	{
+	public:
+		enum class Result : uint8_t {
+			RUNNING,
+			DONE,
+			FAILED
+		};
+
+		Autotune() :
+			setpoint(0),
+			relay_on(false),
+			switch_ons(0),
+			peak_min(0),
+			peak_max(0),
+			start_timestamp(0),
+			switch_on_timestamp(0),
+			period_sum_ms(0),
+			amplitude_sum(0)
+		{
+		}
+
+		void start(int16_t _setpoint)
+		{
+			setpoint = _setpoint;
+			relay_on = false;
+			switch_ons = 0;
+			start_timestamp = millis();
+			period_sum_ms = 0;
+			amplitude_sum = 0;
+		}
+
+		bool isHeating() const
+		{
+			return relay_on;
+		}
+
+		// Called once per update period
+		Result run(int16_t input)
+		{
+			if (millis() - start_timestamp > max_duration_ms) {
+				return Result::FAILED;
+			}
+
+			peak_min = min(peak_min, input);
+			peak_max = max(peak_max, input);
+
+			if (relay_on && input >= setpoint + hysteresis_10th_c) {
+				relay_on = false;
+			}
+			else if (!relay_on && input <= setpoint - hysteresis_10th_c) {
+				relay_on = true;
+
+				// Every switch on completes a cycle, the first one is
+				// skipped as it still contains the approach
+				if (switch_ons >= 2) {
+					period_sum_ms += millis() - switch_on_timestamp;
+					amplitude_sum += (peak_max - peak_min) / 2;
+				}
+
+				++switch_ons;
+				switch_on_timestamp = millis();
+				peak_min = input;
+				peak_max = input;
+
+				if (switch_ons == measured_cycles + 2) {
+					return Result::DONE;
+				}
+			}
+
+			return Result::RUNNING;
+		}
+
+		// Ku = 4d / (πa) with the relay swinging d = 500 ‰ around its
+		// middle, then the Ziegler-Nichols "no overshoot" Kp = 0.2 Ku and
+		// Ti = Tu / 2 with the classic Td = Tu / 8, as the 1/10 °C steps
+		// of the sensors make a stronger derivative jumpy
+		Controller::Configuration::Pid getGains() const
+		{
+			const uint32_t period_ms = period_sum_ms / measured_cycles;
+			const int32_t amplitude = max(amplitude_sum / measured_cycles, 1);
+
+			// 0.2 * 4 * 500 * 256 * 113 / 355, π being 355/113
+			const int32_t kp = min(32595L / amplitude, INT16_MAX);
+			const int32_t ki = min(kp * 1200L / max(period_ms / 100UL, 1UL), INT16_MAX);
+			const int32_t kd = min(kp * static_cast<int32_t>(period_ms / 1000UL) / 480L, INT16_MAX);
+
+			return {
+				static_cast<int16_t>(kp),
+				static_cast<int16_t>(ki),
+				static_cast<int16_t>(kd)
+			};
+		}
+
+	private:
+		static constexpr int16_t hysteresis_10th_c = 2;
+		static constexpr uint8_t measured_cycles = 3;
+		static constexpr uint32_t max_duration_ms = 6UL * 60UL * 60UL * 1000UL;
+
+		int16_t setpoint;
+		bool relay_on;
+		uint8_t switch_ons;
+		int16_t peak_min;
+		int16_t peak_max;
+		uint32_t start_timestamp;
+		uint32_t switch_on_timestamp;
+		uint32_t period_sum_ms;
+		int32_t amplitude_sum;
+	};
+
+	// Survives all resets but power-on, see Crc.hpp. Refreshed with
+	// every update.
+	struct Snapshot {
+		Controller::State state;
+		PidState pid_states[Controller::ZONE_COUNT];
+		bool clock_set;
+		uint32_t seconds_of_day;
+		EnergyBudgetState energy_budget;
+		uint16_t crc;
+	};
+
+	// A constructor would have the C runtime overwrite it on every reset
+	static_assert(__has_trivial_constructor(Snapshot), "Snapshot must be trivially constructible");
+
+	Snapshot snapshot __attribute__((section(".noinit")));
+
+	uint8_t reset_flags __attribute__((section(".noinit")));
+
+	// Runs before the C runtime initializes RAM. A watchdog reset leaves
+	// the watchdog enabled, so it has to be stopped this early.
+	void captureResetFlags() __attribute__((naked, used, section(".init3")));
+
+	void captureResetFlags()
+	{
+		reset_flags = MCUSR;
+		MCUSR = 0;
+		wdt_disable();
+	}
+
 }
 
 class Controller::Implementation final
@@ -58,10 +830,10 @@ class Controller::Implementation final
 public:
 	Implementation() :
 		configuration{
-			95,
-			110,
-			100,
-			200,
+			{
+				{95, 110},
+				{100, 200}
+			},
 			750,
 			700,
 			0,
@@ -69,7 +841,28 @@ public:
 			5,
 			140,
 			180,
-			Configuration::AutoMode::INDEPENDENT
+			Configuration::AutoMode::INDEPENDENT,
+			3,
+			1,
+			{
+				{12800, 640, 0},
+				{12800, 640, 0}
+			},
+			10,
+			5,
+			Configuration::DhtB::ROOM,
+			10,
+			{
+				{{95, 110}, {100, 200}},
+				{{95, 110}, {100, 200}},
+				{{95, 110}, {100, 200}}
+			},
+			{20, 20},
+			0,
+			Controller::ZONE_COUNT,
+			0,
+			Configuration::FanMode::STEPPED,
+			30
 		},
 		state{
 			false,
@@ -79,11 +872,23 @@ public:
 			0,
 			Mode::AUTO,
 			Fan::Speed::OFF,
+			{},
+			Led::Color::RED,
+			{},
 			false,
-			false,
-			Led::Color::RED
+			0,
+			0,
+			Schedule::no_profile,
+			{},
+			0,
+			0,
+			0
 		},
-		next_update_timestamp(0),
+		warm_restart(false),
+		first_valid_control_ms(0),
+		heating_cycle_timestamp(0),
+		autotune_zone(LOUNGE),
+		max_rules_micros(0),
 		fan_timer(FanTimer::OFF),
 		fan_timer_timestamp(0),
 		fan_speedup_timestamp(0)
@@ -96,10 +901,14 @@ public:
 		heating.begin();
 		led.begin();
 		sensors.begin();
+		schedule.begin();
 
 		loadConfiguration();
-		fan.setLowSpeed(configuration.fan_speed_low);
-		fan.setHighSpeed(configuration.fan_speed_high);
+		applyConfiguration();
+
+		restoreSnapshot();
+
+		startHeatingCycle();
 	}
 
 	const Configuration& getConfiguration() const
@@ -109,94 +918,224 @@ public:
 
 	void setConfiguration(const Configuration& value)
 	{
+		if (value.auto_mode != configuration.auto_mode) {
+			resetPid();
+		}
+
 		configuration = value;
-		fan.setLowSpeed(value.fan_speed_low);
-		fan.setHighSpeed(value.fan_speed_high);
+		applyConfiguration();
 		saveConfiguration();
 	}
 
-	void run()
+	void update()
 	{
-		if (timeAfter(millis(), next_update_timestamp)) {
-			next_update_timestamp = millis() + 2500UL;
+		rtc.run();
+		if (schedule.run(rtc.isSet(), rtc.getMinuteOfDay())) {
+			state.profile = schedule.getActiveProfile();
+			updateFloorThresholds();
+		}
+
+		updateEnergyBudget();
 
+		// Until a reading arrived the sensors only hold placeholders, so
+		// the values restored after a warm restart are kept, and after a
+		// cold start the input is invalid
+		if (sensors.areRoomValuesRead() || !sensors.areRoomValuesValid()) {
 			state.room_values_valid = sensors.areRoomValuesValid();
 			state.temperature_10th_c = sensors.getTemperature10thC();
 			state.humidity_per_mill = sensors.getHumidityPerMill();
+		}
+		else if (!warm_restart) {
+			state.room_values_valid = false;
+		}
 
+		if (sensors.isFloorValueRead() || !sensors.isFloorValueValid()) {
 			state.floor_value_valid = sensors.isFloorValueValid();
 			state.floor_temperature_10th_c = sensors.getFloorTemperature10thC();
+		}
+		else if (!warm_restart) {
+			state.floor_value_valid = false;
+		}
 
-			if (state.mode == Mode::AUTO) {
-				switch (configuration.auto_mode) {
-					case Configuration::AutoMode::INDEPENDENT: {
-						if (state.room_values_valid) {
-							if (!state.heating_lounge && state.temperature_10th_c <= configuration.min_room_temperature_10th_c) {
-								state.heating_lounge = true;
-							}
-							else if (state.heating_lounge && state.temperature_10th_c >= configuration.max_room_temperature_10th_c) {
-								state.heating_lounge = false;
-							}
-						}
-
-						if (state.floor_value_valid) {
-							if (!state.heating_vestibule && state.floor_temperature_10th_c <= configuration.min_floor_temperature_10th_c) {
-								state.heating_vestibule = true;
-							}
-							else if (state.heating_vestibule && state.floor_temperature_10th_c >= configuration.max_floor_temperature_10th_c) {
-								state.heating_vestibule = false;
-							}
-						}
-						break;
-					}
+		state.outdoor_values_valid = sensors.isOutdoorValueValid();
+		state.outdoor_temperature_10th_c = sensors.getOutdoorTemperature10thC();
+		state.outdoor_humidity_per_mill = sensors.getOutdoorHumidityPerMill();
 
-					case Configuration::AutoMode::LINKED: {
-						if (state.room_values_valid && state.floor_value_valid) {
-							if (
-								!state.heating_lounge
-								&& (
-									state.temperature_10th_c <= configuration.min_room_temperature_10th_c
-									|| state.floor_temperature_10th_c <= configuration.min_floor_temperature_10th_c
-								)
-								&& state.floor_temperature_10th_c < configuration.max_floor_temperature_10th_c
-							) {
-								state.heating_lounge = true;
-								state.heating_vestibule = true;
-							}
-							else if (state.heating_lounge && state.floor_temperature_10th_c >= configuration.max_floor_temperature_10th_c) {
-								state.heating_lounge = false;
-								state.heating_vestibule = false;
-							}
-						}
-						break;
-					}
+		state.dew_point_10th_c = Psychrometrics::getDewPoint10thC(state.temperature_10th_c, state.humidity_per_mill);
+		state.absolute_humidity_10th_g_per_m3 = Psychrometrics::getAbsoluteHumidity10thGPerM3(state.temperature_10th_c, state.humidity_per_mill);
+
+		bool valid[ZONE_COUNT];
+		int16_t input_10th_c[ZONE_COUNT];
+		int16_t feed_forward[ZONE_COUNT];
+		uint16_t zone_conditions[ZONE_COUNT];
+
+		uint16_t conditions = ALL_VALID;
+		bool any_heating = false;
+		bool all_read = true;
+
+		for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			const Input input = getZoneDefinition(zone).input;
+			const Configuration::Band& band = getBand(zone);
+
+			valid[zone] = isInputValid(input);
+			input_10th_c[zone] = getInput10thC(input);
+
+			models[zone].run(valid[zone], input_10th_c[zone], state.output[zone] == Output::ON);
+
+			// Decide on where the temperature will be shortly, so heating
+			// stops before overshooting and starts before falling short
+			const int16_t forecast_10th_c = models[zone].predict(input_10th_c[zone], state.heating[zone], configuration.prediction_minutes);
+
+			// Heat loss grows with the difference to outdoors, so demand
+			// is anticipated from it rather than waiting for it to cool
+			feed_forward[zone] = getFeedForward(getSetpoint10thC(zone));
+
+			uint16_t zone_condition = 0;
+			if (valid[zone]) {
+				zone_condition |= ZONE_VALID;
+			} else {
+				conditions &= ~ALL_VALID;
+			}
+			if (!isInputRead(input)) {
+				all_read = false;
+			}
+			if (forecast_10th_c <= getOnThreshold(band.min_temperature_10th_c, band.max_temperature_10th_c, feed_forward[zone])) {
+				zone_condition |= ZONE_LOW;
+				conditions |= ANY_LOW;
+			}
+			if (forecast_10th_c >= band.max_temperature_10th_c) {
+				zone_condition |= ZONE_HIGH;
+				if (zone == linked_lead_zone) {
+					conditions |= LEAD_HIGH;
 				}
+			}
+			if (state.heating[zone]) {
+				zone_condition |= ZONE_HEATING;
+			}
+			zone_conditions[zone] = zone_condition;
+		}
 
-				if (fan_timer != FanTimer::PAUSE && state.room_values_valid) {
-					if (state.fan_speed == Fan::Speed::OFF && state.humidity_per_mill >= configuration.max_humidity_per_mill) {
-						state.fan_speed = Fan::Speed::LOW;
-						fan_speedup_timestamp = millis() + configuration.fan_speedup_delay_minutes * 60UL * 1000UL;
-					}
-					else if (state.fan_speed != Fan::Speed::OFF && state.humidity_per_mill <= configuration.min_humidity_per_mill) {
-						state.fan_speed = Fan::Speed::OFF;
-						fan_timer = FanTimer::OFF;
-					}
+		if (!first_valid_control_ms && all_read && (conditions & ALL_VALID)) {
+			first_valid_control_ms = max(millis(), 1UL);
+		}
+
+		if (state.mode == Mode::AUTO) {
+			const uint32_t rules_start = micros();
+
+			if (state.room_values_valid) {
+				conditions |= HUMIDITY_VALID;
+			}
+			if (state.humidity_per_mill >= configuration.max_humidity_per_mill) {
+				conditions |= HUMIDITY_HIGH;
+			}
+			if (state.humidity_per_mill <= configuration.min_humidity_per_mill) {
+				conditions |= HUMIDITY_LOW;
+			}
+			if (state.fan_speed != Fan::Speed::OFF) {
+				conditions |= FAN_RUNNING;
+			}
+			if (fan_timer == FanTimer::PAUSE) {
+				conditions |= FAN_PAUSED;
+			}
+			// Moist air only condenses where it meets the cold floor
+			if (configuration.dew_point_margin_10th_c && state.room_values_valid && state.floor_value_valid) {
+				const int16_t distance_10th_c = state.floor_temperature_10th_c - state.dew_point_10th_c;
+
+				if (distance_10th_c > configuration.dew_point_margin_10th_c) {
+					conditions |= DEW_POINT_FAR;
 				}
+				if (distance_10th_c > configuration.dew_point_margin_10th_c + dew_point_hysteresis_10th_c) {
+					conditions |= DEW_POINT_CLEAR;
+				}
+			}
 
-				if (state.room_values_valid && state.floor_value_valid) {
-					if (state.heating_lounge || state.heating_vestibule) {
-						state.led_color = Led::Color::YELLOW;
-					} else {
-						state.led_color = Led::Color::GREEN;
-					}
+			RuleTable table;
+			memcpy_P(&table, auto_mode_rules + static_cast<uint8_t>(configuration.auto_mode), sizeof(table));
+
+			for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+				const uint8_t actions = evaluateRules(table.rules, table.count, conditions | zone_conditions[zone]);
+
+				if (actions & HEAT_ON) {
+					state.heating[zone] = true;
+				}
+				if (actions & HEAT_OFF) {
+					state.heating[zone] = false;
+				}
+			}
+
+			const uint8_t actions = evaluateRules(fan_rules, sizeof(fan_rules) / sizeof(Rule), conditions);
+
+			// Either mode starts and stops at the humidity limits, the
+			// continuous duty only replaces the LOW and HIGH steps
+			if (actions & FAN_START) {
+				state.fan_speed = configuration.fan_mode == Configuration::FanMode::CONTINUOUS
+					? Fan::Speed::VARIABLE
+					: Fan::Speed::LOW;
+				fan_speedup_timestamp = millis() + configuration.fan_speedup_delay_minutes * 60UL * 1000UL;
+			}
+			if (actions & FAN_STOP) {
+				state.fan_speed = Fan::Speed::OFF;
+				fan_timer = FanTimer::OFF;
+			}
+
+			max_rules_micros = max(max_rules_micros, static_cast<uint16_t>(micros() - rules_start));
+
+			for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+				// Aim at the middle of the configured bands
+				if (configuration.auto_mode == Configuration::AutoMode::PID && valid[zone]) {
+					state.duty_per_mill[zone] = pid_states[zone].run(
+						configuration.pids[zone],
+						getSetpoint10thC(zone),
+						input_10th_c[zone],
+						feed_forward[zone]
+					);
+				}
+
+				any_heating = any_heating || state.heating[zone];
+			}
+
+			if (conditions & ALL_VALID) {
+				if (any_heating) {
+					state.led_color = Led::Color::YELLOW;
 				} else {
-					state.led_color = Led::Color::RED;
+					state.led_color = Led::Color::GREEN;
 				}
+			} else {
+				state.led_color = Led::Color::RED;
+			}
+		}
+		else if (state.mode == Mode::AUTOTUNE) {
+			runAutotune();
+		}
+
+		saveSnapshot();
+	}
+
+	void run()
+	{
+		sensors.run();
+
+		const uint32_t cycle_ms = getHeatingCycleMs();
+		uint32_t elapsed_ms = millis() - heating_cycle_timestamp;
+
+		if (elapsed_ms >= cycle_ms) {
+			startHeatingCycle();
+			elapsed_ms = 0;
+		}
+
+		if (state.mode == Mode::AUTO && configuration.auto_mode == Configuration::AutoMode::PID) {
+			// Time proportioned output: on for the duty share of each cycle
+			for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+				state.heating[zone] = elapsed_ms < cycle_ms / 1000UL * state.duty_per_mill[zone];
 			}
 		}
 
 		if (state.mode == Mode::AUTO) {
-			if (state.fan_speed == Fan::Speed::LOW && timeAfter(millis(), fan_speedup_timestamp)) {
+			if (
+				configuration.fan_mode == Configuration::FanMode::STEPPED
+				&& state.fan_speed == Fan::Speed::LOW
+				&& timeAfter(millis(), fan_speedup_timestamp)
+			) {
 				state.fan_speed = Fan::Speed::HIGH;
 			}
 
@@ -221,9 +1160,35 @@ public:
 		}
 
 		fan.setSpeed(state.fan_speed);
+		if (state.fan_speed == Fan::Speed::VARIABLE) {
+			fan.setDuty(getContinuousFanDuty());
+		}
+		fan.run();
+		state.fan_duty = fan.getDuty();
 
-		heating.setLounge(state.heating_lounge);
-		heating.setVestibule(state.heating_vestibule);
+		// Out of budget for the rest of the cycle, nothing may heat
+		const bool budget_allowed = energy_budget.isAllowed(configuration.daily_energy_wh);
+
+		bool demand[ZONE_COUNT];
+		for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			demand[zone] = state.heating[zone] && budget_allowed;
+		}
+
+		power_limiter.run(configuration, demand, state.output);
+
+		uint16_t load_watts = 0;
+		for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			if (state.heating[zone] && !budget_allowed) {
+				state.output[zone] = Output::HELD;
+			}
+
+			heating.set(getZoneDefinition(zone).heater, power_limiter.isPowered(zone));
+			if (power_limiter.isPowered(zone)) {
+				load_watts += configuration.heater_watts[zone];
+			}
+		}
+
+		energy_budget.integrate(load_watts);
 
 		led.setColor(state.led_color);
 	}
@@ -237,6 +1202,15 @@ public:
 
 			Serial.print(F("  Humidity: "));
 			printHumidity(state.humidity_per_mill);
+
+			Serial.print(F("  Dew point: "));
+			printTemperature(state.dew_point_10th_c);
+
+			Serial.print(F("  Absolute humidity: "));
+			Serial.print(state.absolute_humidity_10th_g_per_m3 / 10);
+			Serial.print(F("."));
+			Serial.print(state.absolute_humidity_10th_g_per_m3 % 10);
+			Serial.println(F(" g/m³"));
 		} else {
 			Serial.println(F("  Error reading room values."));
 		}
@@ -244,12 +1218,85 @@ public:
 		if (state.floor_value_valid) {
 			Serial.print(F("  Floor temperature: "));
 			printTemperature(state.floor_temperature_10th_c);
+
+			Serial.print(F("  Floor resolution: "));
+			Serial.print(sensors.getActiveFloorResolution());
+			Serial.print(F(" bit"));
+			if (sensors.getActiveFloorResolution() != sensors.getFloorResolution()) {
+				Serial.print(F(" (requested "));
+				Serial.print(sensors.getFloorResolution());
+				Serial.print(F(")"));
+			}
+			Serial.println();
 		} else {
 			Serial.println(F("  Error reading floor value."));
 		}
 
+		if (configuration.dht_b == Configuration::DhtB::OUTDOOR) {
+			if (state.outdoor_values_valid) {
+				Serial.print(F("  Outdoor temperature: "));
+				printTemperature(state.outdoor_temperature_10th_c);
+
+				Serial.print(F("  Outdoor humidity: "));
+				printHumidity(state.outdoor_humidity_per_mill);
+			} else {
+				Serial.println(F("  Error reading outdoor values."));
+			}
+		}
+
 		Serial.println(F("State:"));
 
+		Serial.print(F("  Time: "));
+		if (rtc.isSet()) {
+			const uint32_t seconds = rtc.getSecondsOfDay();
+			print02(seconds / 3600UL);
+			Serial.print(F(":"));
+			print02(seconds / 60UL % 60UL);
+			Serial.print(F(":"));
+			print02(seconds % 60UL);
+			Serial.println();
+		} else {
+			Serial.println(F("not set"));
+		}
+
+		Serial.print(F("  Profile: "));
+		if (state.profile < Schedule::profile_count) {
+			Serial.println(state.profile);
+		} else {
+			Serial.println(F("none"));
+		}
+
+		Serial.print(F("  Reset cause:"));
+		if (reset_flags & _BV(PORF)) {
+			Serial.print(F(" POWER-ON"));
+		}
+		if (reset_flags & _BV(EXTRF)) {
+			Serial.print(F(" EXTERNAL"));
+		}
+		if (reset_flags & _BV(BORF)) {
+			Serial.print(F(" BROWN-OUT"));
+		}
+		if (reset_flags & _BV(WDRF)) {
+			Serial.print(F(" WATCHDOG"));
+		}
+		if (!(reset_flags & (_BV(PORF) | _BV(EXTRF) | _BV(BORF) | _BV(WDRF)))) {
+			Serial.print(F(" unknown"));
+		}
+		Serial.println();
+		Serial.print(F("  Warm restart: "));
+		Serial.println(warm_restart ? F("yes") : F("no"));
+		Serial.print(F("  First valid control after: "));
+		if (first_valid_control_ms) {
+			Serial.print(first_valid_control_ms);
+			Serial.println(F(" ms"));
+		} else {
+			Serial.println(F("pending"));
+		}
+
+		Serial.print(F("  Rule evaluation max: "));
+		Serial.print(max_rules_micros);
+		Serial.println(F(" µs"));
+
 		Serial.print(F("  Operational mode: "));
 		switch (state.mode) {
 			case Mode::AUTO: {
@@ -261,6 +1308,12 @@ public:
 				Serial.println(F("MANUAL"));
 				break;
 			}
+
+			case Mode::AUTOTUNE: {
+				Serial.print(F("AUTOTUNE "));
+				Serial.println(Controller::getZoneName(autotune_zone));
+				break;
+			}
 		}
 
 		Serial.print(F("  Fan speed: "));
@@ -279,31 +1332,51 @@ public:
 				Serial.println(F("HIGH"));
 				break;
 			}
-		}
-
-		Serial.print(F("  Lounge heating: "));
-		switch (state.heating_lounge) {
-			case false: {
-				Serial.println(F("OFF"));
-				break;
-			}
 
-			case true: {
-				Serial.println(F("ON"));
+			case Fan::Speed::VARIABLE: {
+				Serial.println(F("VARIABLE"));
 				break;
 			}
 		}
+		Serial.print(F("  Fan duty: "));
+		Serial.println(static_cast<unsigned int>(state.fan_duty));
+
+		for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			Serial.print(F("  "));
+			Serial.print(Controller::getZoneName(zone));
+			Serial.print(F(" heating: "));
+			switch (state.output[zone]) {
+				case Output::OFF: {
+					Serial.println(F("OFF"));
+					break;
+				}
 
-		Serial.print(F("  Vestibule heating: "));
-		switch (state.heating_vestibule) {
-			case false: {
-				Serial.println(F("OFF"));
-				break;
+				case Output::ON: {
+					Serial.println(F("ON"));
+					break;
+				}
+
+				case Output::STAGGERED: {
+					Serial.println(F("STAGGERED"));
+					break;
+				}
+
+				case Output::SHED: {
+					Serial.println(F("SHED"));
+					break;
+				}
+
+				case Output::HELD: {
+					Serial.println(F("HELD"));
+					break;
+				}
 			}
 
-			case true: {
-				Serial.println(F("ON"));
-				break;
+			if (configuration.auto_mode == Configuration::AutoMode::PID) {
+				Serial.print(F("  "));
+				Serial.print(Controller::getZoneName(zone));
+				Serial.print(F(" duty: "));
+				printDuty(state.duty_per_mill[zone]);
 			}
 		}
 
@@ -327,20 +1400,39 @@ public:
 
 		Serial.println(F("Configuration:"));
 
-		Serial.print(F("  Minimum room temperature: "));
-		printTemperature(configuration.min_room_temperature_10th_c);
-		Serial.print(F("  Maximum room temperature: "));
-		printTemperature(configuration.max_room_temperature_10th_c);
+		for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			Serial.print(F("  Minimum "));
+			Serial.print(Controller::getZoneInputName(zone));
+			Serial.print(F(" temperature: "));
+			printTemperature(configuration.bands[zone].min_temperature_10th_c);
+			Serial.print(F("  Maximum "));
+			Serial.print(Controller::getZoneInputName(zone));
+			Serial.print(F(" temperature: "));
+			printTemperature(configuration.bands[zone].max_temperature_10th_c);
+		}
 
-		Serial.print(F("  Minimum floor temperature: "));
-		printTemperature(configuration.min_floor_temperature_10th_c);
-		Serial.print(F("  Maximum floor temperature: "));
-		printTemperature(configuration.max_floor_temperature_10th_c);
+		for (uint8_t profile = 0; profile < Schedule::profile_count; ++profile) {
+			Serial.print(F("  Profile "));
+			Serial.print(profile);
+			Serial.println(F(":"));
+			for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+				Serial.print(F("    "));
+				Serial.print(Controller::getZoneName(zone));
+				Serial.print(F(": "));
+				printBand(configuration.profiles[profile][zone]);
+			}
+		}
 
 		Serial.print(F("  Maximum humidity: "));
 		printHumidity(configuration.max_humidity_per_mill);
 		Serial.print(F("  Minimum humidity: "));
 		printHumidity(configuration.min_humidity_per_mill);
+		Serial.print(F("  Dew point margin: "));
+		if (configuration.dew_point_margin_10th_c) {
+			printTemperature(configuration.dew_point_margin_10th_c);
+		} else {
+			Serial.println(F("off"));
+		}
 
 		Serial.print(F("  Fan maximum run minutes: "));
 		if (configuration.fan_max_run_minutes) {
@@ -356,6 +1448,18 @@ public:
 		Serial.println(static_cast<unsigned int>(configuration.fan_speed_low));
 		Serial.print(F("  Fan speed HIGH value: "));
 		Serial.println(static_cast<unsigned int>(configuration.fan_speed_high));
+		Serial.print(F("  Fan mode: "));
+		switch (configuration.fan_mode) {
+			case Configuration::FanMode::STEPPED: {
+				Serial.println(F("STEPPED"));
+				break;
+			}
+
+			case Configuration::FanMode::CONTINUOUS: {
+				Serial.println(F("CONTINUOUS"));
+				break;
+			}
+		}
 
 		Serial.print(F("  Auto mode: "));
 		switch (configuration.auto_mode) {
@@ -368,7 +1472,105 @@ public:
 				Serial.println(F("LINKED"));
 				break;
 			}
+
+			case Configuration::AutoMode::PID: {
+				Serial.println(F("PID"));
+				break;
+			}
+		}
+
+		Serial.print(F("  Filter median length: "));
+		Serial.println(static_cast<unsigned int>(configuration.filter_median_length));
+		Serial.print(F("  Filter EWMA shift: "));
+		Serial.println(static_cast<unsigned int>(configuration.filter_ewma_shift));
+
+		for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			Serial.print(F("  "));
+			Serial.print(Controller::getZoneName(zone));
+			Serial.print(F(" PID gains: "));
+			printPid(configuration.pids[zone]);
+		}
+		for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			Serial.print(F("  "));
+			Serial.print(Controller::getZoneName(zone));
+			Serial.print(F(" heater: "));
+			Serial.print(configuration.heater_watts[zone]);
+			Serial.println(F(" W"));
+		}
+		Serial.print(F("  Maximum load: "));
+		if (configuration.max_load_watts) {
+			Serial.print(configuration.max_load_watts);
+			Serial.println(F(" W"));
+		} else {
+			Serial.println(F("unlimited"));
+		}
+		Serial.print(F("  Priority zone: "));
+		if (configuration.priority_zone < ZONE_COUNT) {
+			Serial.println(Controller::getZoneName(configuration.priority_zone));
+		} else {
+			Serial.println(F("none"));
+		}
+		Serial.print(F("  Daily energy budget: "));
+		if (configuration.daily_energy_wh) {
+			Serial.print(configuration.daily_energy_wh);
+			Serial.println(F(" Wh"));
+		} else {
+			Serial.println(F("unlimited"));
+		}
+
+		const Energy energy = getEnergy();
+		Serial.println(F("Energy today:"));
+		Serial.print(F("  Used: "));
+		Serial.print(energy.used_wh);
+		Serial.println(F(" Wh"));
+		Serial.print(F("  Projected: "));
+		Serial.print(energy.projected_wh);
+		Serial.println(F(" Wh"));
+		if (configuration.daily_energy_wh) {
+			Serial.print(F("  Remaining: "));
+			Serial.print(energy.remaining_wh);
+			Serial.println(F(" Wh"));
+			Serial.print(F("  This hour's allowance: "));
+			Serial.print(energy.hour_allowance_wh);
+			Serial.println(F(" Wh"));
+		}
+		Serial.print(F("  Heating cycle minutes: "));
+		Serial.println(static_cast<unsigned int>(configuration.heating_cycle_minutes));
+		Serial.print(F("  Prediction minutes: "));
+		Serial.println(static_cast<unsigned int>(configuration.prediction_minutes));
+		Serial.print(F("  DHT22 B: "));
+		switch (configuration.dht_b) {
+			case Configuration::DhtB::ROOM: {
+				Serial.println(F("ROOM"));
+				break;
+			}
+
+			case Configuration::DhtB::OUTDOOR: {
+				Serial.println(F("OUTDOOR"));
+				break;
+			}
+		}
+		Serial.print(F("  Outdoor feed-forward: "));
+		Serial.print(static_cast<unsigned int>(configuration.outdoor_feed_forward_per_mill));
+		Serial.println(F("‰/°C"));
+
+		Serial.println(F("Thermal model (per hour):"));
+		for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			Serial.print(F("  "));
+			Serial.print(Controller::getZoneName(zone));
+			if (models[zone].isTrained()) {
+				Serial.print(F(" heat loss: "));
+				printSlope(-models[zone].getSlope(false));
+				Serial.print(F("  "));
+				Serial.print(Controller::getZoneName(zone));
+				Serial.print(F(" heater gain: "));
+				printSlope(models[zone].getSlope(true) - models[zone].getSlope(false));
+			} else {
+				Serial.println(F(" still learning."));
+			}
 		}
+
+		schedule.dump();
 	}
 
 	const State& getState() const
@@ -385,30 +1587,66 @@ public:
 	{
 		state.mode = Mode::AUTO;
 
+		resetPid();
+
 		state.fan_speed = Fan::Speed::OFF;
 		fan_timer = FanTimer::OFF;
 	}
 
-	void setFanSpeed(Fan::Speed value)
+	void setTime(uint32_t seconds_of_day)
 	{
-		state.mode = Mode::MANUAL;
+		rtc.setSecondsOfDay(seconds_of_day);
+		schedule.invalidate();
+	}
 
-		state.fan_speed = value;
+	void setScheduleEntry(uint8_t index, const Schedule::Entry& value)
+	{
+		schedule.setEntry(index, value);
+	}
+
+	Energy getEnergy() const
+	{
+		return energy_budget.getEnergy(configuration.daily_energy_wh);
+	}
+
+	bool isWarmRestart() const
+	{
+		return warm_restart;
+	}
+
+	bool startAutotune(uint8_t zone)
+	{
+		if (zone >= ZONE_COUNT || !isInputValid(getZoneDefinition(zone).input)) {
+			return false;
+		}
+
+		state.mode = Mode::AUTOTUNE;
+		autotune_zone = zone;
+
+		autotune.start(getSetpoint10thC(zone));
+
+		for (uint8_t i = 0; i < ZONE_COUNT; ++i) {
+			state.heating[i] = false;
+		}
+		state.fan_speed = Fan::Speed::OFF;
 		fan_timer = FanTimer::OFF;
+
+		return true;
 	}
 
-	void setHeatingLounge(bool value)
+	void setFanSpeed(Fan::Speed value)
 	{
 		state.mode = Mode::MANUAL;
 
-		state.heating_lounge = value;
+		state.fan_speed = value;
+		fan_timer = FanTimer::OFF;
 	}
 
-	void setHeatingVestibule(bool value)
+	void setHeating(uint8_t zone, bool value)
 	{
 		state.mode = Mode::MANUAL;
 
-		state.heating_vestibule = value;
+		state.heating[zone] = value;
 	}
 
 	void setLedColor(Led::Color value)
@@ -425,13 +1663,226 @@ private:
 		PAUSE
 	};
 
+	void runAutotune()
+	{
+		const Input input = getZoneDefinition(autotune_zone).input;
+		const Autotune::Result result =
+			isInputValid(input)
+				? autotune.run(getInput10thC(input))
+				: Autotune::Result::FAILED;
+
+		switch (result) {
+			case Autotune::Result::RUNNING: {
+				state.heating[autotune_zone] = autotune.isHeating();
+				state.led_color = Led::Color::YELLOW;
+				return;
+			}
+
+			case Autotune::Result::DONE: {
+				Configuration value = configuration;
+				value.pids[autotune_zone] = autotune.getGains();
+				setConfiguration(value);
+				break;
+			}
+
+			case Autotune::Result::FAILED: {
+				break;
+			}
+		}
+
+		state.heating[autotune_zone] = false;
+		setAutoMode();
+	}
+
+	bool isInputValid(Input input) const
+	{
+		return input == Input::ROOM ? state.room_values_valid : state.floor_value_valid;
+	}
+
+	bool isInputRead(Input input) const
+	{
+		return input == Input::ROOM ? sensors.areRoomValuesRead() : sensors.isFloorValueRead();
+	}
+
+	int16_t getInput10thC(Input input) const
+	{
+		return input == Input::ROOM ? state.temperature_10th_c : state.floor_temperature_10th_c;
+	}
+
+	// The bands of the scheduled profile, if any
+	const Configuration::Band& getBand(uint8_t zone) const
+	{
+		return
+			state.profile < Schedule::profile_count
+				? configuration.profiles[state.profile][zone]
+				: configuration.bands[zone];
+	}
+
+	int16_t getSetpoint10thC(uint8_t zone) const
+	{
+		const Configuration::Band& band = getBand(zone);
+
+		return (band.min_temperature_10th_c + band.max_temperature_10th_c) / 2;
+	}
+
+	// Duty in ‰ to compensate the loss to outdoors at the given setpoint
+	int16_t getFeedForward(int16_t setpoint_10th_c) const
+	{
+		if (!state.outdoor_values_valid || state.outdoor_temperature_10th_c >= setpoint_10th_c) {
+			return 0;
+		}
+
+		const int32_t difference_10th_c = static_cast<int32_t>(setpoint_10th_c) - state.outdoor_temperature_10th_c;
+
+		return min(difference_10th_c * configuration.outdoor_feed_forward_per_mill / 10, 1000L);
+	}
+
+	// On/off modes switch on earlier within the band the higher the demand
+	static int16_t getOnThreshold(int16_t min_10th_c, int16_t max_10th_c, int16_t feed_forward)
+	{
+		if (max_10th_c <= min_10th_c) {
+			return min_10th_c;
+		}
+
+		const int32_t band_10th_c = static_cast<int32_t>(max_10th_c) - min_10th_c;
+
+		return min_10th_c + min(band_10th_c * feed_forward / 1000, band_10th_c - 1);
+	}
+
+	void resetPid()
+	{
+		for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			pid_states[zone].reset();
+			state.duty_per_mill[zone] = 0;
+		}
+		startHeatingCycle();
+	}
+
+	uint32_t getHeatingCycleMs() const
+	{
+		return max(configuration.heating_cycle_minutes, 1) * 60UL * 1000UL;
+	}
+
+	void startHeatingCycle()
+	{
+		heating_cycle_timestamp = millis();
+		energy_budget.startCycle(getHeatingCycleMs());
+	}
+
+	uint8_t getContinuousFanDuty() const
+	{
+		const int16_t span = max(configuration.max_humidity_per_mill - configuration.min_humidity_per_mill, 1);
+		const int16_t excess = constrain(state.humidity_per_mill - configuration.min_humidity_per_mill, 0, span);
+
+		return configuration.fan_speed_low
+			+ static_cast<int32_t>(configuration.fan_speed_high - configuration.fan_speed_low) * excess / span;
+	}
+
+	void applyConfiguration()
+	{
+		fan.setLowSpeed(configuration.fan_speed_low);
+		fan.setHighSpeed(configuration.fan_speed_high);
+		updateFloorThresholds();
+		sensors.setFilter(configuration.filter_median_length, configuration.filter_ewma_shift);
+		sensors.setOutdoorProbe(configuration.dht_b == Configuration::DhtB::OUTDOOR);
+	}
+
+	// Coldness is judged by the outdoor temperature if available, else by
+	// the first zone's, against the highest setpoint
+	void updateEnergyBudget()
+	{
+		int16_t reference_10th_c = INT16_MIN;
+		for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			reference_10th_c = max(reference_10th_c, getSetpoint10thC(zone));
+		}
+
+		const Input input = getZoneDefinition(0).input;
+
+		energy_budget.update(
+			configuration.daily_energy_wh,
+			rtc.getSecondsOfDay(),
+			state.outdoor_values_valid || isInputValid(input),
+			state.outdoor_values_valid ? state.outdoor_temperature_10th_c : getInput10thC(input),
+			reference_10th_c
+		);
+	}
+
+	void updateFloorThresholds()
+	{
+		for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			if (getZoneDefinition(zone).input == Input::FLOOR) {
+				sensors.setFloorThresholds(getBand(zone).min_temperature_10th_c, getBand(zone).max_temperature_10th_c);
+			}
+		}
+	}
+
 	void loadConfiguration()
 	{
+		const Configuration defaults = configuration;
+
 		if (EEPROM.read(0) != 0xFF) {
 			EEPROM.get(1, configuration);
-			if (configuration.auto_mode != Configuration::AutoMode::INDEPENDENT && configuration.auto_mode != Configuration::AutoMode::LINKED) {
+			if (
+				configuration.auto_mode != Configuration::AutoMode::INDEPENDENT
+				&& configuration.auto_mode != Configuration::AutoMode::LINKED
+				&& configuration.auto_mode != Configuration::AutoMode::PID
+			) {
 				configuration.auto_mode = Configuration::AutoMode::INDEPENDENT;
 			}
+			if (!configuration.filter_median_length || configuration.filter_median_length > Sensors::max_filter_median_length) {
+				configuration.filter_median_length = 3;
+			}
+			if (configuration.filter_ewma_shift > Sensors::max_filter_ewma_shift) {
+				configuration.filter_ewma_shift = 1;
+			}
+			// Erased EEPROM reads back as negative gains
+			for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+				const Configuration::Pid& pid = configuration.pids[zone];
+				if (pid.kp < 0 || pid.ki < 0 || pid.kd < 0) {
+					configuration.pids[zone] = defaults.pids[zone];
+				}
+			}
+			if (!configuration.heating_cycle_minutes || configuration.heating_cycle_minutes == 0xFF) {
+				configuration.heating_cycle_minutes = defaults.heating_cycle_minutes;
+			}
+			if (configuration.prediction_minutes == 0xFF) {
+				configuration.prediction_minutes = defaults.prediction_minutes;
+			}
+			if (configuration.dht_b != Configuration::DhtB::ROOM && configuration.dht_b != Configuration::DhtB::OUTDOOR) {
+				configuration.dht_b = defaults.dht_b;
+			}
+			if (configuration.outdoor_feed_forward_per_mill == 0xFF) {
+				configuration.outdoor_feed_forward_per_mill = defaults.outdoor_feed_forward_per_mill;
+			}
+			for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+				if (configuration.heater_watts[zone] == 0xFFFF) {
+					configuration.heater_watts[zone] = defaults.heater_watts[zone];
+				}
+			}
+			if (configuration.max_load_watts == 0xFFFF) {
+				configuration.max_load_watts = defaults.max_load_watts;
+			}
+			if (configuration.daily_energy_wh == 0xFFFF) {
+				configuration.daily_energy_wh = defaults.daily_energy_wh;
+			}
+			if (
+				configuration.fan_mode != Configuration::FanMode::STEPPED
+				&& configuration.fan_mode != Configuration::FanMode::CONTINUOUS
+			) {
+				configuration.fan_mode = defaults.fan_mode;
+			}
+			if (configuration.dew_point_margin_10th_c == 0xFF) {
+				configuration.dew_point_margin_10th_c = defaults.dew_point_margin_10th_c;
+			}
+			// Profiles never written start out as the plain bands
+			for (uint8_t profile = 0; profile < Schedule::profile_count; ++profile) {
+				for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+					Configuration::Band& band = configuration.profiles[profile][zone];
+					if (band.min_temperature_10th_c == -1 && band.max_temperature_10th_c == -1) {
+						band = configuration.bands[zone];
+					}
+				}
+			}
 		}
 	}
 
@@ -441,10 +1892,65 @@ private:
 		EEPROM.put(1, configuration);
 	}
 
+	void saveSnapshot()
+	{
+		snapshot.state = state;
+		for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			snapshot.pid_states[zone] = pid_states[zone].getState();
+		}
+		snapshot.clock_set = rtc.isSet();
+		snapshot.seconds_of_day = rtc.getSecondsOfDay();
+		snapshot.energy_budget = energy_budget.getState();
+		snapshot.crc = Crc::get(&snapshot, offsetof(Snapshot, crc));
+	}
+
+	// After a brownout or watchdog reset carry on where the last update
+	// left off, instead of with the heaters off until the sensors are up
+	void restoreSnapshot()
+	{
+		warm_restart = !(reset_flags & _BV(PORF)) && snapshot.crc == Crc::get(&snapshot, offsetof(Snapshot, crc));
+
+		if (!warm_restart) {
+			return;
+		}
+
+		state = snapshot.state;
+		for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			pid_states[zone].setState(snapshot.pid_states[zone]);
+		}
+		// Today's energy use only means something with the time of day
+		if (snapshot.clock_set) {
+			rtc.setSecondsOfDay(snapshot.seconds_of_day);
+			energy_budget.setState(snapshot.energy_budget);
+		}
+
+		// Autotuning can't be resumed half way
+		if (state.mode == Mode::AUTOTUNE) {
+			state.mode = Mode::AUTO;
+			for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+				state.heating[zone] = false;
+			}
+		}
+	}
+
 	Configuration configuration;
 	State state;
 
-	uint32_t next_update_timestamp;
+	bool warm_restart;
+	uint32_t first_valid_control_ms;
+
+	Pid pid_states[ZONE_COUNT];
+	uint32_t heating_cycle_timestamp;
+
+	Autotune autotune;
+	uint8_t autotune_zone;
+
+	ThermalModel models[ZONE_COUNT];
+
+	uint16_t max_rules_micros;
+
+	PowerLimiter power_limiter;
+	EnergyBudget energy_budget;
 
 	FanTimer fan_timer;
 	uint32_t fan_timer_timestamp;
@@ -461,6 +1967,26 @@ Controller::~Controller()
 	delete implementation;
 }
 
+const __FlashStringHelper* Controller::getZoneName(uint8_t zone)
+{
+	return reinterpret_cast<const __FlashStringHelper*>(getZoneDefinition(zone).name);
+}
+
+const __FlashStringHelper* Controller::getZoneInputName(uint8_t zone)
+{
+	switch (getZoneDefinition(zone).input) {
+		case Input::ROOM: {
+			return F("room");
+		}
+
+		case Input::FLOOR: {
+			return F("floor");
+		}
+	}
+
+	return F("");
+}
+
 void Controller::begin()
 {
 	implementation->begin();
@@ -481,6 +2007,11 @@ void Controller::run()
 	implementation->run();
 }
 
+void Controller::update()
+{
+	implementation->update();
+}
+
 void Controller::dump() const
 {
 	implementation->dump();
@@ -491,6 +2022,46 @@ const Controller::State& Controller::getState() const
 	return implementation->getState();
 }
 
+const Sensors& Controller::getSensors() const
+{
+	return sensors;
+}
+
+const Clock& Controller::getClock() const
+{
+	return rtc;
+}
+
+void Controller::setTime(uint32_t seconds_of_day)
+{
+	implementation->setTime(seconds_of_day);
+}
+
+Controller::Energy Controller::getEnergy() const
+{
+	return implementation->getEnergy();
+}
+
+uint8_t Controller::getResetFlags() const
+{
+	return reset_flags;
+}
+
+bool Controller::isWarmRestart() const
+{
+	return implementation->isWarmRestart();
+}
+
+const Schedule& Controller::getSchedule() const
+{
+	return schedule;
+}
+
+void Controller::setScheduleEntry(uint8_t index, const Schedule::Entry& value)
+{
+	implementation->setScheduleEntry(index, value);
+}
+
 Controller::Mode Controller::getMode() const
 {
 	return implementation->getMode();
@@ -501,19 +2072,19 @@ void Controller::setAutoMode()
 	implementation->setAutoMode();
 }
 
-void Controller::setFanSpeed(Fan::Speed value)
+bool Controller::startAutotune(uint8_t zone)
 {
-	implementation->setFanSpeed(value);
+	return implementation->startAutotune(zone);
 }
 
-void Controller::setHeatingLounge(bool value)
+void Controller::setFanSpeed(Fan::Speed value)
 {
-	implementation->setHeatingLounge(value);
+	implementation->setFanSpeed(value);
 }
 
-void Controller::setHeatingVestibule(bool value)
+void Controller::setHeating(uint8_t zone, bool value)
 {
-	implementation->setHeatingVestibule(value);
+	implementation->setHeating(zone, value);
 }
 
 void Controller::setLedColor(Led::Color value)
@@ -22,30 +22,71 @@
 
 #include <Arduino.h>
 
+#include "Clock.hpp"
 #include "Fan.hpp"
 #include "Heating.hpp"
 #include "Led.hpp"
+#include "Schedule.hpp"
 #include "Sensors.hpp"
 
 class Controller final
 {
 public:
+	static constexpr uint32_t update_period_ms = 2500;
+
 	enum class Mode : uint8_t {
 		AUTO,
-		MANUAL
+		MANUAL,
+		AUTOTUNE
+	};
+
+	enum Zone : uint8_t {
+		LOUNGE,
+		VESTIBULE,
+		ZONE_COUNT
+	};
+
+	// What a zone's heater does, heating demanded may wait for the turn
+	// on stagger, be held off by the power limit (shed) or by the energy
+	// budget (held)
+	enum class Output : uint8_t {
+		OFF,
+		ON,
+		STAGGERED,
+		SHED,
+		HELD
 	};
 
 	struct Configuration {
 		enum class AutoMode : uint8_t {
 			INDEPENDENT,
-			LINKED
+			LINKED,
+			PID
+		};
+
+		enum class DhtB : uint8_t {
+			ROOM,
+			OUTDOOR
+		};
+
+		enum class FanMode : uint8_t {
+			STEPPED,
+			CONTINUOUS
 		};
 
-		int16_t min_room_temperature_10th_c;
-		int16_t max_room_temperature_10th_c;
+		// Error in 1/10 °C, output in per mill, gains in 1/256
+		struct Pid {
+			int16_t kp; // ‰ per 1/10 °C
+			int16_t ki; // ‰ per 1/10 °C and minute
+			int16_t kd; // ‰ per 1/10 °C per minute
+		};
+
+		struct Band {
+			int16_t min_temperature_10th_c;
+			int16_t max_temperature_10th_c;
+		};
 
-		int16_t min_floor_temperature_10th_c;
-		int16_t max_floor_temperature_10th_c;
+		Band bands[ZONE_COUNT];
 
 		int16_t max_humidity_per_mill;
 		int16_t min_humidity_per_mill;
@@ -57,6 +98,33 @@ public:
 		uint8_t fan_speed_high;
 
 		AutoMode auto_mode;
+
+		uint8_t filter_median_length;
+		uint8_t filter_ewma_shift;
+
+		Pid pids[ZONE_COUNT];
+		uint8_t heating_cycle_minutes;
+
+		uint8_t prediction_minutes;
+
+		DhtB dht_b;
+		uint8_t outdoor_feed_forward_per_mill; // Duty per °C below the setpoint
+
+		// Replace the bands while selected by the schedule
+		Band profiles[Schedule::profile_count][ZONE_COUNT];
+
+		uint16_t heater_watts[ZONE_COUNT];
+		uint16_t max_load_watts; // 0 for no limit
+		uint8_t priority_zone; // ZONE_COUNT or above for none
+
+		uint16_t daily_energy_wh; // 0 for no budget
+
+		// Duty follows the humidity from LOW at minimum to HIGH at maximum
+		FanMode fan_mode;
+
+		// Only ventilate while the floor is this close to the dew point,
+		// 0 to go by humidity alone
+		uint8_t dew_point_margin_10th_c;
 	};
 
 	struct State {
@@ -71,33 +139,79 @@ public:
 
 		Fan::Speed fan_speed;
 
-		bool heating_lounge;
-		bool heating_vestibule;
+		bool heating[ZONE_COUNT];
 
 		Led::Color led_color;
+
+		uint16_t duty_per_mill[ZONE_COUNT];
+
+		bool outdoor_values_valid;
+		int16_t outdoor_temperature_10th_c;
+		int16_t outdoor_humidity_per_mill;
+
+		uint8_t profile;
+
+		Output output[ZONE_COUNT];
+
+		uint8_t fan_duty;
+
+		int16_t dew_point_10th_c;
+		uint16_t absolute_humidity_10th_g_per_m3;
+	};
+
+	struct Energy {
+		uint16_t budget_wh;
+		uint16_t used_wh;
+		uint16_t remaining_wh;
+		uint16_t projected_wh; // By the end of the day at today's rate
+		uint16_t hour_allowance_wh;
 	};
 
 	Controller();
 	~Controller();
 
+	// Zones are named after their space, e.g. "Lounge", and the sensor
+	// input they are controlled by, e.g. "room"
+	static const __FlashStringHelper* getZoneName(uint8_t zone);
+	static const __FlashStringHelper* getZoneInputName(uint8_t zone);
+
 	void begin();
 
 	const Configuration& getConfiguration() const;
 	void setConfiguration(const Configuration& value);
 
+	// Polls the sensors and drives the outputs, call every millisecond
 	void run();
+	// Control decisions, call every update_period_ms
+	void update();
 
 	void dump() const;
 
 	const State& getState() const;
 
+	const Sensors& getSensors() const;
+
+	const Clock& getClock() const;
+	void setTime(uint32_t seconds_of_day);
+
+	Energy getEnergy() const;
+
+	// MCUSR as found at startup
+	uint8_t getResetFlags() const;
+	// State was carried over from before a reset other than power-on
+	bool isWarmRestart() const;
+
+	const Schedule& getSchedule() const;
+	void setScheduleEntry(uint8_t index, const Schedule::Entry& value);
+
 	Mode getMode() const;
 	void setAutoMode();
 
+	bool startAutotune(uint8_t zone);
+
 	void setFanSpeed(Fan::Speed value);
 
-	void setHeatingLounge(bool value);
-	void setHeatingVestibule(bool value);
+	void setHeating(uint8_t zone, bool value);
 
 	void setLedColor(Led::Color value);
 
@@ -0,0 +1,35 @@
+/*
+	CavyCave - A temperature controlled box for guinea pigs and other
+		small animals kept outside in winter
+
+	Copyright (C) 2020-2021 Flössie <floessie.mail@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <util/crc16.h>
+
+#include "Crc.hpp"
+
+uint16_t Crc::get(const void* data, size_t size)
+{
+	const uint8_t* const bytes = static_cast<const uint8_t*>(data);
+
+	uint16_t crc = 0xFFFF;
+	for (size_t i = 0; i < size; ++i) {
+		crc = _crc16_update(crc, bytes[i]);
+	}
+
+	return crc;
+}
@@ -0,0 +1,34 @@
+/*
+	CavyCave - A temperature controlled box for guinea pigs and other
+		small animals kept outside in winter
+
+	Copyright (C) 2020-2021 Flössie <floessie.mail@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-16 over state kept in the .noinit section. That RAM is left alone
+// by the C runtime, so it survives all resets but power-on, when it holds
+// garbage the CRC has to tell apart from a valid copy.
+namespace Crc
+{
+
+	uint16_t get(const void* data, size_t size);
+
+}
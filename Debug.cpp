@@ -24,6 +24,7 @@
 
 #include "Controller.hpp"
 #include "Radio.hpp"
+#include "Scheduler.hpp"
 #include "Stats.hpp"
 
 namespace
@@ -45,7 +46,181 @@ namespace
 		Serial.println(F("%"));
 	}
 
-	void handle(const String& command, Controller& controller, Radio& radio, Stats& stats)
+	// Parses decimals like "-12.5" into tenths, truncating further digits
+	int16_t parse10th(const String& value)
+	{
+		unsigned int i = 0;
+
+		const bool negative = i < value.length() && value[i] == '-';
+		if (negative || (i < value.length() && value[i] == '+')) {
+			++i;
+		}
+
+		int16_t result = 0;
+		for (; i < value.length() && value[i] >= '0' && value[i] <= '9'; ++i) {
+			result = result * 10 + (value[i] - '0');
+		}
+		result *= 10;
+
+		if (i < value.length() && value[i] == '.') {
+			++i;
+			if (i < value.length() && value[i] >= '0' && value[i] <= '9') {
+				result += value[i] - '0';
+			}
+		}
+
+		return negative ? -result : result;
+	}
+
+	// Parses "kp,ki,kd"
+	bool parsePid(const String& value, Controller::Configuration::Pid& pid)
+	{
+		const int first = value.indexOf(',');
+		const int second = first < 0 ? -1 : value.indexOf(',', first + 1);
+
+		if (second < 0) {
+			return false;
+		}
+
+		pid.kp = value.substring(0, first).toInt();
+		pid.ki = value.substring(first + 1, second).toInt();
+		pid.kd = value.substring(second + 1).toInt();
+
+		return pid.kp >= 0 && pid.ki >= 0 && pid.kd >= 0;
+	}
+
+	// Parses "HH:MM" or "HH:MM:SS" into seconds of the day
+	bool parseTime(const String& value, uint32_t& seconds)
+	{
+		const int first = value.indexOf(':');
+		const int second = first < 0 ? -1 : value.indexOf(':', first + 1);
+
+		if (first < 0) {
+			return false;
+		}
+
+		const long hours = value.substring(0, first).toInt();
+		const long minutes = value.substring(first + 1, second < 0 ? value.length() : second).toInt();
+		const long secs = second < 0 ? 0 : value.substring(second + 1).toInt();
+
+		if (hours < 0 || hours > 23 || minutes < 0 || minutes > 59 || secs < 0 || secs > 59) {
+			return false;
+		}
+
+		seconds = hours * 3600L + minutes * 60L + secs;
+		return true;
+	}
+
+	void printPid(const Controller::Configuration::Pid& pid)
+	{
+		Serial.print(pid.kp);
+		Serial.print(F(", "));
+		Serial.print(pid.ki);
+		Serial.print(F(", "));
+		Serial.println(pid.kd);
+	}
+
+	// Zone commands are derived from the zone table: "lounge=on",
+	// "autotune=lounge", "lounge_pid=kp,ki,kd" and "min_room_temp=9.5"
+	// for a zone named "Lounge" controlled by the room temperature
+	bool handleZone(const String& cmd, const String& val, uint8_t zone, Controller& controller)
+	{
+		String name = Controller::getZoneName(zone);
+		name.toLowerCase();
+
+		String pid_cmd = name;
+		pid_cmd += F("_pid");
+
+		String watts_cmd = name;
+		watts_cmd += F("_watts");
+
+		String min_cmd = F("min_");
+		min_cmd += Controller::getZoneInputName(zone);
+		min_cmd += F("_temp");
+
+		String max_cmd = F("max_");
+		max_cmd += Controller::getZoneInputName(zone);
+		max_cmd += F("_temp");
+
+		if (cmd == name && (val == F("on") || val == F("off"))) {
+			const bool on = val == F("on");
+			controller.setHeating(zone, on);
+			Serial.print(Controller::getZoneName(zone));
+			if (on) {
+				Serial.println(F(" heating ON"));
+			} else {
+				Serial.println(F(" heating OFF"));
+			}
+			return true;
+		}
+
+		if (cmd == F("autotune") && val == name) {
+			Serial.print(Controller::getZoneName(zone));
+			if (controller.startAutotune(zone)) {
+				Serial.println(F(" autotune started"));
+			} else {
+				Serial.print(F(" autotune needs a valid "));
+				Serial.print(Controller::getZoneInputName(zone));
+				Serial.println(F(" temperature"));
+			}
+			return true;
+		}
+
+		if (cmd == pid_cmd) {
+			Controller::Configuration configuration = controller.getConfiguration();
+			if (parsePid(val, configuration.pids[zone])) {
+				controller.setConfiguration(configuration);
+				Serial.print(Controller::getZoneName(zone));
+				Serial.print(F(" PID gains set to "));
+				printPid(configuration.pids[zone]);
+				return true;
+			}
+			return false;
+		}
+
+		if (cmd == watts_cmd) {
+			const uint16_t v = constrain(val.toInt(), 0, 10000);
+			Controller::Configuration configuration = controller.getConfiguration();
+			configuration.heater_watts[zone] = v;
+			controller.setConfiguration(configuration);
+			Serial.print(Controller::getZoneName(zone));
+			Serial.print(F(" heater set to "));
+			Serial.print(v);
+			Serial.println(F(" W"));
+			return true;
+		}
+
+		if (cmd == F("priority_zone") && val == name) {
+			Controller::Configuration configuration = controller.getConfiguration();
+			configuration.priority_zone = zone;
+			controller.setConfiguration(configuration);
+			Serial.print(F("Priority zone set to "));
+			Serial.println(Controller::getZoneName(zone));
+			return true;
+		}
+
+		if (cmd == min_cmd || cmd == max_cmd) {
+			const bool is_min = cmd == min_cmd;
+			const int16_t v = parse10th(val);
+			Controller::Configuration configuration = controller.getConfiguration();
+			if (is_min) {
+				configuration.bands[zone].min_temperature_10th_c = v;
+				Serial.print(F("Minimum "));
+			} else {
+				configuration.bands[zone].max_temperature_10th_c = v;
+				Serial.print(F("Maximum "));
+			}
+			controller.setConfiguration(configuration);
+			Serial.print(Controller::getZoneInputName(zone));
+			Serial.print(F(" temperature set to "));
+			printTemperature(v);
+			return true;
+		}
+
+		return false;
+	}
+
+	void handle(const String& command, Controller& controller, Radio& radio, Stats& stats, Scheduler& scheduler)
 	{
 		bool handled = false;
 
@@ -53,6 +228,7 @@ namespace
 			controller.dump();
 			stats.dump();
 			radio.dump();
+			scheduler.dump();
 			handled = true;
 		}
 		else if (command == F("auto")) {
@@ -60,6 +236,14 @@ namespace
 			Serial.println(F("Mode set to AUTO"));
 			handled = true;
 		}
+		else if (command == F("sensors")) {
+			controller.getSensors().dump();
+			handled = true;
+		}
+		else if (command == F("tasks")) {
+			scheduler.dump();
+			handled = true;
+		}
 		else if (command == F("reset")) {
 			stats.reset();
 			Serial.println(F("Statistics reset"));
@@ -90,30 +274,6 @@ namespace
 					handled = true;
 				}
 			}
-			else if (cmd == F("lounge")) {
-				if (val == F("on")) {
-					controller.setHeatingLounge(true);
-					Serial.println(F("Lounge heating ON"));
-					handled = true;
-				}
-				else if (val == F("off")) {
-					controller.setHeatingLounge(false);
-					Serial.println(F("Lounge heating OFF"));
-					handled = true;
-				}
-			}
-			else if (cmd == F("vestibule")) {
-				if (val == F("on")) {
-					controller.setHeatingVestibule(true);
-					Serial.println(F("Vestibule heating ON"));
-					handled = true;
-				}
-				else if (val == F("off")) {
-					controller.setHeatingVestibule(false);
-					Serial.println(F("Vestibule heating OFF"));
-					handled = true;
-				}
-			}
 			else if (cmd == F("led")) {
 				if (val == F("green")) {
 					controller.setLedColor(Led::Color::GREEN);
@@ -131,47 +291,8 @@ namespace
 					handled = true;
 				}
 			}
-			else if (cmd == F("min_room_temp")) {
-				const int16_t v = val.toFloat() * 10;
-				Controller::Configuration configuration = controller.getConfiguration();
-				configuration.min_room_temperature_10th_c = v;
-				controller.setConfiguration(configuration);
-				Serial.print(F("Minimum room temperature set to "));
-				printTemperature(v);
-				handled = true;
-			}
-			else if (cmd == F("max_room_temp")) {
-				const int16_t v = val.toFloat() * 10;
-				Controller::Configuration configuration = controller.getConfiguration();
-				configuration.max_room_temperature_10th_c = v;
-				controller.setConfiguration(configuration);
-				Serial.print(F("Maximum room temperature set to "));
-				printTemperature(v);
-				handled = true;
-			}
-			else if (cmd == F("min_floor_temp")) {
-				const int16_t v = val.toFloat() * 10;
-				Controller::Configuration configuration = controller.getConfiguration();
-				configuration.min_floor_temperature_10th_c = v;
-				controller.setConfiguration(configuration);
-				Serial.print(F("Minimum floor temperature set to "));
-				Serial.print(v / 10);
-				Serial.print(F("."));
-				Serial.print(abs(v) % 10);
-				Serial.println(F("°C"));
-				handled = true;
-			}
-			else if (cmd == F("max_floor_temp")) {
-				const int16_t v = val.toFloat() * 10;
-				Controller::Configuration configuration = controller.getConfiguration();
-				configuration.max_floor_temperature_10th_c = v;
-				controller.setConfiguration(configuration);
-				Serial.print(F("Maximum floor temperature set to "));
-				printTemperature(v);
-				handled = true;
-			}
 			else if (cmd == F("max_humidity")) {
-				const int16_t v = val.toFloat() * 10;
+				const int16_t v = parse10th(val);
 				Controller::Configuration configuration = controller.getConfiguration();
 				configuration.max_humidity_per_mill = v;
 				controller.setConfiguration(configuration);
@@ -180,7 +301,7 @@ namespace
 				handled = true;
 			}
 			else if (cmd == F("min_humidity")) {
-				const int16_t v = val.toFloat() * 10;
+				const int16_t v = parse10th(val);
 				Controller::Configuration configuration = controller.getConfiguration();
 				configuration.min_humidity_per_mill = v;
 				controller.setConfiguration(configuration);
@@ -237,6 +358,46 @@ namespace
 				Serial.println(static_cast<unsigned int>(v));
 				handled = true;
 			}
+			else if (cmd == F("filter_median_length")) {
+				const uint8_t v = constrain(val.toInt(), 1, Sensors::max_filter_median_length);
+				Controller::Configuration configuration = controller.getConfiguration();
+				configuration.filter_median_length = v;
+				controller.setConfiguration(configuration);
+				Serial.print(F("Filter median length set to "));
+				Serial.println(static_cast<unsigned int>(v));
+				handled = true;
+			}
+			else if (cmd == F("filter_ewma_shift")) {
+				const uint8_t v = constrain(val.toInt(), 0, Sensors::max_filter_ewma_shift);
+				Controller::Configuration configuration = controller.getConfiguration();
+				configuration.filter_ewma_shift = v;
+				controller.setConfiguration(configuration);
+				Serial.print(F("Filter EWMA shift set to "));
+				Serial.println(static_cast<unsigned int>(v));
+				handled = true;
+			}
+			else if (cmd == F("heating_cycle_minutes")) {
+				const uint8_t v = constrain(val.toInt(), 1, 254);
+				Controller::Configuration configuration = controller.getConfiguration();
+				configuration.heating_cycle_minutes = v;
+				controller.setConfiguration(configuration);
+				Serial.print(F("Heating cycle minutes set to "));
+				Serial.println(static_cast<unsigned int>(v));
+				handled = true;
+			}
+			else if (cmd == F("prediction_minutes")) {
+				const uint8_t v = constrain(val.toInt(), 0, 254);
+				Controller::Configuration configuration = controller.getConfiguration();
+				configuration.prediction_minutes = v;
+				controller.setConfiguration(configuration);
+				Serial.print(F("Prediction minutes set to "));
+				if (v) {
+					Serial.println(static_cast<unsigned int>(v));
+				} else {
+					Serial.println(F("off"));
+				}
+				handled = true;
+			}
 			else if (cmd == F("auto_mode")) {
 				Controller::Configuration configuration = controller.getConfiguration();
 				if (val == F("independent")) {
@@ -249,10 +410,178 @@ namespace
 					Serial.println(F("Auto mode set to LINKED"));
 					handled = true;
 				}
+				if (val == F("pid")) {
+					configuration.auto_mode = Controller::Configuration::AutoMode::PID;
+					Serial.println(F("Auto mode set to PID"));
+					handled = true;
+				}
+				if (handled) {
+					controller.setConfiguration(configuration);
+				}
+			}
+			else if (cmd == F("dew_point_margin")) {
+				const uint8_t v = constrain(parse10th(val), 0, 254);
+				Controller::Configuration configuration = controller.getConfiguration();
+				configuration.dew_point_margin_10th_c = v;
+				controller.setConfiguration(configuration);
+				Serial.print(F("Dew point margin set to "));
+				if (v) {
+					printTemperature(v);
+				} else {
+					Serial.println(F("off"));
+				}
+				handled = true;
+			}
+			else if (cmd == F("fan_mode")) {
+				Controller::Configuration configuration = controller.getConfiguration();
+				if (val == F("stepped")) {
+					configuration.fan_mode = Controller::Configuration::FanMode::STEPPED;
+					Serial.println(F("Fan mode set to STEPPED"));
+					handled = true;
+				}
+				if (val == F("continuous")) {
+					configuration.fan_mode = Controller::Configuration::FanMode::CONTINUOUS;
+					Serial.println(F("Fan mode set to CONTINUOUS"));
+					handled = true;
+				}
+				if (handled) {
+					controller.setConfiguration(configuration);
+				}
+			}
+			else if (cmd == F("dht_b")) {
+				Controller::Configuration configuration = controller.getConfiguration();
+				if (val == F("room")) {
+					configuration.dht_b = Controller::Configuration::DhtB::ROOM;
+					Serial.println(F("DHT22 B set to ROOM"));
+					handled = true;
+				}
+				if (val == F("outdoor")) {
+					configuration.dht_b = Controller::Configuration::DhtB::OUTDOOR;
+					Serial.println(F("DHT22 B set to OUTDOOR"));
+					handled = true;
+				}
 				if (handled) {
 					controller.setConfiguration(configuration);
 				}
 			}
+			else if (cmd == F("outdoor_feed_forward")) {
+				const uint8_t v = constrain(val.toInt(), 0, 254);
+				Controller::Configuration configuration = controller.getConfiguration();
+				configuration.outdoor_feed_forward_per_mill = v;
+				controller.setConfiguration(configuration);
+				Serial.print(F("Outdoor feed-forward set to "));
+				Serial.print(static_cast<unsigned int>(v));
+				Serial.println(F("‰/°C"));
+				handled = true;
+			}
+			else if (cmd == F("max_load_watts")) {
+				const uint16_t v = constrain(val.toInt(), 0, 10000);
+				Controller::Configuration configuration = controller.getConfiguration();
+				configuration.max_load_watts = v;
+				controller.setConfiguration(configuration);
+				Serial.print(F("Maximum load set to "));
+				if (v) {
+					Serial.print(v);
+					Serial.println(F(" W"));
+				} else {
+					Serial.println(F("unlimited"));
+				}
+				handled = true;
+			}
+			else if (cmd == F("priority_zone") && val == F("none")) {
+				Controller::Configuration configuration = controller.getConfiguration();
+				configuration.priority_zone = Controller::ZONE_COUNT;
+				controller.setConfiguration(configuration);
+				Serial.println(F("Priority zone set to none"));
+				handled = true;
+			}
+			else if (cmd == F("daily_energy_wh")) {
+				const uint16_t v = constrain(val.toInt(), 0, 60000);
+				Controller::Configuration configuration = controller.getConfiguration();
+				configuration.daily_energy_wh = v;
+				controller.setConfiguration(configuration);
+				Serial.print(F("Daily energy budget set to "));
+				if (v) {
+					Serial.print(v);
+					Serial.println(F(" Wh"));
+				} else {
+					Serial.println(F("unlimited"));
+				}
+				handled = true;
+			}
+			else if (cmd == F("time")) {
+				uint32_t seconds;
+				if (parseTime(val, seconds)) {
+					controller.setTime(seconds);
+					Serial.print(F("Time set to "));
+					Serial.println(val);
+					handled = true;
+				}
+			}
+			else if (cmd == F("schedule")) {
+				// "slot,HH:MM,profile" or "slot,off"
+				const int first = val.indexOf(',');
+				const int second = first < 0 ? -1 : val.indexOf(',', first + 1);
+				const long slot = first < 0 ? -1 : val.substring(0, first).toInt();
+
+				if (slot >= 0 && slot < Schedule::entry_count) {
+					Schedule::Entry entry = {Schedule::unused, Schedule::no_profile};
+					uint32_t seconds;
+
+					if (val.substring(first + 1) == F("off")) {
+						handled = true;
+					}
+					else if (second > 0 && parseTime(val.substring(first + 1, second), seconds)) {
+						const long profile = val.substring(second + 1).toInt();
+						if (profile >= 0 && profile < Schedule::profile_count) {
+							entry = {static_cast<uint16_t>(seconds / 60UL), static_cast<uint8_t>(profile)};
+							handled = true;
+						}
+					}
+
+					if (handled) {
+						controller.setScheduleEntry(slot, entry);
+						controller.getSchedule().dump();
+					}
+				}
+			}
+			else if (cmd == F("profile")) {
+				// "profile,zone,min,max" with the zone by name
+				const int first = val.indexOf(',');
+				const int second = first < 0 ? -1 : val.indexOf(',', first + 1);
+				const int third = second < 0 ? -1 : val.indexOf(',', second + 1);
+				const long profile = first < 0 ? -1 : val.substring(0, first).toInt();
+
+				if (third > 0 && profile >= 0 && profile < Schedule::profile_count) {
+					const String& zone_name = val.substring(first + 1, second);
+
+					for (uint8_t zone = 0; zone < Controller::ZONE_COUNT && !handled; ++zone) {
+						String name = Controller::getZoneName(zone);
+						name.toLowerCase();
+
+						if (zone_name == name) {
+							Controller::Configuration configuration = controller.getConfiguration();
+							Controller::Configuration::Band& band = configuration.profiles[profile][zone];
+							band.min_temperature_10th_c = parse10th(val.substring(second + 1, third));
+							band.max_temperature_10th_c = parse10th(val.substring(third + 1));
+							controller.setConfiguration(configuration);
+							Serial.print(F("Profile "));
+							Serial.print(profile);
+							Serial.print(F(" "));
+							Serial.print(Controller::getZoneName(zone));
+							Serial.print(F(" minimum set to "));
+							printTemperature(band.min_temperature_10th_c);
+							Serial.print(F("Profile "));
+							Serial.print(profile);
+							Serial.print(F(" "));
+							Serial.print(Controller::getZoneName(zone));
+							Serial.print(F(" maximum set to "));
+							printTemperature(band.max_temperature_10th_c);
+							handled = true;
+						}
+					}
+				}
+			}
 			else if (cmd == F("channel")) {
 				const uint8_t v = val.toInt();
 				Radio::Configuration configuration = radio.getConfiguration();
@@ -308,6 +637,10 @@ namespace
 
 				handled = true;
 			}
+
+			for (uint8_t zone = 0; zone < Controller::ZONE_COUNT && !handled; ++zone) {
+				handled = handleZone(cmd, val, zone, controller);
+			}
 		}
 
 		if (!handled) {
@@ -317,10 +650,11 @@ namespace
 
 }
 
-Debug::Debug(Controller& _controller, Radio& _radio, Stats& _stats) :
+Debug::Debug(Controller& _controller, Radio& _radio, Stats& _stats, Scheduler& _scheduler) :
 	controller(_controller),
 	radio(_radio),
-	stats(_stats)
+	stats(_stats),
+	scheduler(_scheduler)
 {
 }
 
@@ -350,7 +684,7 @@ void Debug::onSerialEvent()
 		}
 
 		if (is_eol || command_buffer.length() == command_buffer_size) {
-			handle(command_buffer, controller, radio, stats);
+			handle(command_buffer, controller, radio, stats, scheduler);
 			command_buffer = "";
 		}
 	}
@@ -24,12 +24,13 @@
 
 class Controller;
 class Radio;
+class Scheduler;
 class Stats;
 
 class Debug final
 {
 public:
-	Debug(Controller& _controller, Radio& _radio, Stats& _stats);
+	Debug(Controller& _controller, Radio& _radio, Stats& _stats, Scheduler& _scheduler);
 
 	void begin(uint32_t baudrate);
 
@@ -39,4 +40,5 @@ private:
 	Controller& controller;
 	Radio& radio;
 	Stats& stats;
+	Scheduler& scheduler;
 };
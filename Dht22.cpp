@@ -0,0 +1,194 @@
+/*
+	CavyCave - A temperature controlled box for guinea pigs and other
+		small animals kept outside in winter
+
+	Copyright (C) 2020-2021 Flössie <floessie.mail@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <Arduino.h>
+
+#include "Dht22.hpp"
+
+namespace
+{
+
+	// Response edge, bit edges and end of frame edge
+	constexpr uint8_t frame_edges = 42;
+	// A 0 bit lasts ~78 µs, a 1 bit ~120 µs from falling edge to falling edge
+	constexpr uint16_t one_threshold_micros = 100;
+
+	Dht22* instances[2];
+	uint8_t instance_count = 0;
+	uint8_t previous_pins = 0xFF;
+
+}
+
+Dht22::Dht22(uint8_t _pin) :
+	pin(_pin),
+	mask(digitalPinToBitMask(_pin)),
+	state(State::IDLE),
+	timestamp(0),
+	start_micros(0),
+	edges(0),
+	last_edge_micros(0),
+	data{},
+	temperature_10th_c(0),
+	humidity_per_mill(0)
+{
+	pinMode(pin, INPUT_PULLUP);
+}
+
+void Dht22::begin()
+{
+	if (instance_count < sizeof(instances) / sizeof(*instances)) {
+		instances[instance_count++] = this;
+	}
+
+	previous_pins = PINC;
+	PCICR |= _BV(PCIE1);
+}
+
+bool Dht22::isBusy() const
+{
+	return state != State::IDLE;
+}
+
+void Dht22::start()
+{
+	if (state == State::IDLE) {
+		// Start signal: hold the line low for at least 1 ms
+		digitalWrite(pin, false);
+		pinMode(pin, OUTPUT);
+
+		state = State::STARTING;
+		timestamp = millis();
+	}
+}
+
+Dht22::Result Dht22::run()
+{
+	switch (state) {
+		case State::IDLE: {
+			break;
+		}
+
+		case State::STARTING: {
+			if (millis() - timestamp >= 2) {
+				edges = 0;
+
+				noInterrupts();
+				PCMSK1 |= mask;
+				previous_pins |= mask;
+				interrupts();
+
+				pinMode(pin, INPUT_PULLUP);
+				start_micros = micros();
+
+				state = State::RECEIVING;
+				timestamp = millis();
+			}
+			break;
+		}
+
+		case State::RECEIVING: {
+			if (edges == frame_edges) {
+				state = State::IDLE;
+
+				if (static_cast<uint8_t>(data[0] + data[1] + data[2] + data[3]) != data[4]) {
+					return Result::CHECKSUM_ERROR;
+				}
+
+				humidity_per_mill = data[0] << 8 | data[1];
+				temperature_10th_c = (data[2] & 0x7F) << 8 | data[3];
+				if (data[2] & 0x80) {
+					temperature_10th_c = -temperature_10th_c;
+				}
+
+				return Result::OK;
+			}
+
+			if (millis() - timestamp >= 10) {
+				noInterrupts();
+				PCMSK1 &= ~mask;
+				interrupts();
+
+				state = State::IDLE;
+
+				return Result::TIMEOUT;
+			}
+			break;
+		}
+	}
+
+	return Result::NONE;
+}
+
+int16_t Dht22::getTemperature10thC() const
+{
+	return temperature_10th_c;
+}
+
+int16_t Dht22::getHumidityPerMill() const
+{
+	return humidity_per_mill;
+}
+
+uint16_t Dht22::getReadMicros() const
+{
+	return last_edge_micros - start_micros;
+}
+
+void Dht22::onPinChange()
+{
+	const uint16_t now = micros();
+	const uint8_t pins = PINC;
+	const uint8_t falling = previous_pins & ~pins & PCMSK1;
+
+	previous_pins = pins;
+
+	for (uint8_t i = 0; i < instance_count; ++i) {
+		if (falling & instances[i]->mask) {
+			instances[i]->onFallingEdge(now);
+		}
+	}
+}
+
+void Dht22::onFallingEdge(uint16_t now)
+{
+	const uint8_t edge = edges;
+
+	if (edge >= 2) {
+		const uint8_t bit = edge - 2;
+		volatile uint8_t& byte = data[bit >> 3];
+
+		byte <<= 1;
+		if (static_cast<uint16_t>(now - last_edge_micros) > one_threshold_micros) {
+			byte |= 1;
+		}
+	}
+
+	last_edge_micros = now;
+	edges = edge + 1;
+
+	if (edge + 1 == frame_edges) {
+		PCMSK1 &= ~mask;
+	}
+}
+
+ISR(PCINT1_vect)
+{
+	Dht22::onPinChange();
+}
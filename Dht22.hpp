@@ -0,0 +1,77 @@
+/*
+	CavyCave - A temperature controlled box for guinea pigs and other
+		small animals kept outside in winter
+
+	Copyright (C) 2020-2021 Flössie <floessie.mail@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// DHT22 reader decoding the frame from pin change interrupts, so the
+// main loop keeps running during the ~5 ms transfer. The data pin must
+// be on port C (PCINT1).
+class Dht22 final
+{
+public:
+	enum class Result : uint8_t {
+		NONE,
+		OK,
+		CHECKSUM_ERROR,
+		TIMEOUT
+	};
+
+	explicit Dht22(uint8_t _pin);
+
+	void begin();
+
+	bool isBusy() const;
+	void start();
+
+	Result run();
+
+	int16_t getTemperature10thC() const;
+	int16_t getHumidityPerMill() const;
+
+	uint16_t getReadMicros() const;
+
+	static void onPinChange();
+
+private:
+	enum class State : uint8_t {
+		IDLE,
+		STARTING,
+		RECEIVING
+	};
+
+	void onFallingEdge(uint16_t now);
+
+	const uint8_t pin;
+	const uint8_t mask;
+
+	State state;
+	uint32_t timestamp;
+
+	uint16_t start_micros;
+
+	volatile uint8_t edges;
+	volatile uint16_t last_edge_micros;
+	volatile uint8_t data[5];
+
+	int16_t temperature_10th_c;
+	int16_t humidity_per_mill;
+};
@@ -0,0 +1,180 @@
+/*
+	CavyCave - A temperature controlled box for guinea pigs and other
+		small animals kept outside in winter
+
+	Copyright (C) 2020-2021 Flössie <floessie.mail@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <Arduino.h>
+
+#include "Ds18b20.hpp"
+
+namespace
+{
+
+	enum Command : uint8_t {
+		CONVERT_T = 0x44,
+		WRITE_SCRATCHPAD = 0x4E,
+		READ_SCRATCHPAD = 0xBE
+	};
+
+	constexpr uint8_t family_code = 0x28;
+
+	// 750 ms at 12 bit, halved for every bit less
+	constexpr uint32_t conversionMs(uint8_t resolution)
+	{
+		return 750UL >> (12 - resolution);
+	}
+
+}
+
+Ds18b20::Ds18b20(uint8_t _pin) :
+	one_wire(_pin),
+	address{},
+	address_valid(false),
+	resolution(12),
+	requested_resolution(12),
+	converting(false),
+	timestamp(0),
+	read_micros(0),
+	temperature_10th_c(20)
+{
+}
+
+void Ds18b20::begin()
+{
+	findAddress();
+}
+
+bool Ds18b20::isBusy() const
+{
+	return converting;
+}
+
+bool Ds18b20::start()
+{
+	if (!address_valid && !findAddress()) {
+		return false;
+	}
+
+	if (resolution != requested_resolution) {
+		writeResolution();
+	}
+
+	if (!one_wire.reset()) {
+		return false;
+	}
+
+	one_wire.select(address);
+	one_wire.write(CONVERT_T);
+
+	converting = true;
+	timestamp = millis();
+
+	return true;
+}
+
+Ds18b20::Result Ds18b20::run()
+{
+	if (!converting || millis() - timestamp < conversionMs(resolution)) {
+		return Result::NONE;
+	}
+
+	converting = false;
+
+	uint8_t scratchpad[9];
+
+	const uint32_t start_micros = micros();
+
+	if (!one_wire.reset()) {
+		return Result::NO_RESPONSE;
+	}
+
+	one_wire.select(address);
+	one_wire.write(READ_SCRATCHPAD);
+	one_wire.read_bytes(scratchpad, sizeof(scratchpad));
+
+	read_micros = micros() - start_micros;
+
+	if (OneWire::crc8(scratchpad, 8) != scratchpad[8]) {
+		return Result::CRC_ERROR;
+	}
+
+	// Configuration register holds the resolution in bits 5 and 6, it
+	// falls back to the EEPROM value on power loss
+	resolution = 9 + (scratchpad[4] >> 5 & 0x03);
+
+	// Raw value is in 1/16 °C, with the lower bits undefined below 12 bit
+	const int16_t raw = (scratchpad[1] << 8 | scratchpad[0]) & ~((1 << (12 - resolution)) - 1);
+	temperature_10th_c = (static_cast<int32_t>(raw) * 10 + (raw < 0 ? -8 : 8)) / 16;
+
+	return Result::OK;
+}
+
+uint16_t Ds18b20::getReadMicros() const
+{
+	return read_micros;
+}
+
+void Ds18b20::forgetAddress()
+{
+	address_valid = false;
+	resolution = 12;
+	converting = false;
+}
+
+uint8_t Ds18b20::getResolution() const
+{
+	return resolution;
+}
+
+void Ds18b20::setResolution(uint8_t value)
+{
+	requested_resolution = constrain(value, 9, 12);
+}
+
+int16_t Ds18b20::getTemperature10thC() const
+{
+	return temperature_10th_c;
+}
+
+bool Ds18b20::findAddress()
+{
+	one_wire.reset_search();
+
+	address_valid =
+		one_wire.search(address)
+		&& OneWire::crc8(address, 7) == address[7]
+		&& address[0] == family_code;
+
+	return address_valid;
+}
+
+void Ds18b20::writeResolution()
+{
+	if (!one_wire.reset()) {
+		return;
+	}
+
+	// Only the scratchpad is written, the sensor EEPROM is left alone
+	one_wire.select(address);
+	one_wire.write(WRITE_SCRATCHPAD);
+	one_wire.write(0x4B); // TH, alarms are unused
+	one_wire.write(0x46); // TL
+	one_wire.write((requested_resolution - 9) << 5 | 0x1F);
+
+	resolution = requested_resolution;
+}
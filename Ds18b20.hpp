@@ -0,0 +1,74 @@
+/*
+	CavyCave - A temperature controlled box for guinea pigs and other
+		small animals kept outside in winter
+
+	Copyright (C) 2020-2021 Flössie <floessie.mail@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <OneWire.h>
+
+// Single DS18B20 on its own bus. The ROM code is searched once and then
+// used to address the sensor directly, conversions run in the background.
+class Ds18b20 final
+{
+public:
+	enum class Result : uint8_t {
+		NONE,
+		OK,
+		CRC_ERROR,
+		NO_RESPONSE
+	};
+
+	explicit Ds18b20(uint8_t _pin);
+
+	void begin();
+
+	bool isBusy() const;
+	bool start();
+
+	Result run();
+
+	void forgetAddress();
+
+	uint8_t getResolution() const;
+	void setResolution(uint8_t value);
+
+	int16_t getTemperature10thC() const;
+
+	uint16_t getReadMicros() const;
+
+private:
+	bool findAddress();
+	void writeResolution();
+
+	OneWire one_wire;
+
+	uint8_t address[8];
+	bool address_valid;
+
+	uint8_t resolution;
+	uint8_t requested_resolution;
+
+	bool converting;
+	uint32_t timestamp;
+	uint16_t read_micros;
+
+	int16_t temperature_10th_c;
+};
@@ -24,10 +24,21 @@
 
 #include "Pins.hpp"
 
+namespace
+{
+
+	// Full scale in about 2.5 s
+	constexpr uint32_t ramp_step_ms = 10;
+
+}
+
 Fan::Fan() :
 	speed(Speed::OFF),
 	low_speed(140),
-	high_speed(180)
+	high_speed(180),
+	target_duty(0),
+	duty(0),
+	ramp_timestamp(0)
 {
 	pinMode(Pin::FAN, OUTPUT);
 	analogWrite(Pin::FAN, 0);
@@ -39,6 +50,23 @@ void Fan::begin()
 	TCCR1B = TCCR1B & ~0x07 | 0x05;
 }
 
+void Fan::run()
+{
+	if (duty == target_duty || millis() - ramp_timestamp < ramp_step_ms) {
+		return;
+	}
+
+	ramp_timestamp = millis();
+
+	if (duty < target_duty) {
+		++duty;
+	} else {
+		--duty;
+	}
+
+	analogWrite(Pin::FAN, duty);
+}
+
 Fan::Speed Fan::getSpeed() const
 {
 	return speed;
@@ -50,22 +78,36 @@ void Fan::setSpeed(Speed value)
 
 	switch (value) {
 		case Speed::OFF: {
-			analogWrite(Pin::FAN, 0);
+			target_duty = 0;
 			break;
 		}
 
 		case Speed::LOW: {
-			analogWrite(Pin::FAN, low_speed);
+			target_duty = low_speed;
 			break;
 		}
 
 		case Speed::HIGH: {
-			analogWrite(Pin::FAN, high_speed);
+			target_duty = high_speed;
+			break;
+		}
+
+		case Speed::VARIABLE: {
 			break;
 		}
 	}
 }
 
+uint8_t Fan::getDuty() const
+{
+	return duty;
+}
+
+void Fan::setDuty(uint8_t value)
+{
+	target_duty = value;
+}
+
 void Fan::setLowSpeed(uint8_t value)
 {
 	low_speed = value;
@@ -36,16 +36,25 @@ public:
 	enum class Speed : uint8_t {
 		OFF,
 		LOW,
-		HIGH
+		HIGH,
+		VARIABLE // Duty set through setDuty()
 	};
 
 	Fan();
 
 	void begin();
 
+	// Ramps the PWM towards the requested duty
+	void run();
+
 	Speed getSpeed() const;
 	void setSpeed(Speed value);
 
+	uint8_t getDuty() const;
+	// Overrides the duty of the current speed until the next setSpeed(),
+	// except for VARIABLE which keeps it
+	void setDuty(uint8_t value);
+
 	void setLowSpeed(uint8_t value);
 	void setHighSpeed(uint8_t value);
 
@@ -53,4 +62,7 @@ private:
 	Speed speed;
 	uint8_t low_speed;
 	uint8_t high_speed;
+	uint8_t target_duty;
+	uint8_t duty;
+	uint32_t ramp_timestamp;
 };
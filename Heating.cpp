@@ -24,39 +24,36 @@
 
 #include "Pins.hpp"
 
-Heating::Heating() :
-	lounge(false),
-	vestibule(false)
+namespace
 {
-	pinMode(Pin::HEAT_A, OUTPUT);
-	pinMode(Pin::HEAT_B, OUTPUT);
-	digitalWrite(Pin::HEAT_A, false);
-	digitalWrite(Pin::HEAT_B, false);
-}
 
-void Heating::begin()
-{
+	constexpr uint8_t pins[Heating::output_count] = {
+		Pin::HEAT_A,
+		Pin::HEAT_B
+	};
+
 }
 
-bool Heating::getLounge() const
+Heating::Heating() :
+	outputs{}
 {
-	return lounge;
+	for (uint8_t i = 0; i < output_count; ++i) {
+		pinMode(pins[i], OUTPUT);
+		digitalWrite(pins[i], false);
+	}
 }
 
-void Heating::setLounge(bool value)
+void Heating::begin()
 {
-	lounge = value;
-	digitalWrite(Pin::HEAT_A, value);
 }
 
-bool Heating::getVestibule() const
+bool Heating::get(uint8_t output) const
 {
-	return vestibule;
+	return outputs[output];
 }
 
-void Heating::setVestibule(bool value)
+void Heating::set(uint8_t output, bool value)
 {
-	vestibule = value;
-	digitalWrite(Pin::HEAT_B, value);
+	outputs[output] = value;
+	digitalWrite(pins[output], value);
 }
-
@@ -20,20 +20,20 @@
 
 #pragma once
 
+#include <stdint.h>
+
 class Heating final
 {
 public:
+	static constexpr uint8_t output_count = 2;
+
 	Heating();
 
 	void begin();
 
-	bool getLounge() const;
-	void setLounge(bool value);
-
-	bool getVestibule() const;
-	void setVestibule(bool value);
+	bool get(uint8_t output) const;
+	void set(uint8_t output, bool value);
 
 private:
-	bool lounge;
-	bool vestibule;
+	bool outputs[output_count];
 };
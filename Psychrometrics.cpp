@@ -0,0 +1,106 @@
+/*
+	CavyCave - A temperature controlled box for guinea pigs and other
+		small animals kept outside in winter
+
+	Copyright (C) 2020-2021 Flössie <floessie.mail@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <Arduino.h>
+
+#include "Psychrometrics.hpp"
+
+namespace
+{
+
+	constexpr int16_t table_min_10th_c = -400;
+	constexpr int16_t table_step_10th_c = 50;
+
+	// Every 5 °C from -40 °C to 60 °C, over water. Relative humidity is
+	// measured against this, also below 0 °C.
+	constexpr uint16_t saturation_pressures_pa[] PROGMEM = {
+		19, 32, 51, 81, 126, 192, 287, 422,
+		611, 872, 1226, 1702, 2333, 3160, 4234, 5613,
+		7367, 9580, 12345, 15774, 19993
+	};
+
+	// Over ice from -40 °C to below 0 °C, for where frost forms
+	constexpr uint16_t ice_pressures_pa[] PROGMEM = {
+		13, 22, 38, 63, 103, 165, 260, 402
+	};
+
+	constexpr uint8_t table_size = sizeof(saturation_pressures_pa) / sizeof(uint16_t);
+	constexpr uint8_t ice_table_size = sizeof(ice_pressures_pa) / sizeof(uint16_t);
+
+	uint16_t getTableEntry(uint8_t index)
+	{
+		return pgm_read_word(saturation_pressures_pa + index);
+	}
+
+	uint16_t getFrostTableEntry(uint8_t index)
+	{
+		return index < ice_table_size ? pgm_read_word(ice_pressures_pa + index) : getTableEntry(index);
+	}
+
+}
+
+uint16_t Psychrometrics::getSaturationPressurePa(int16_t temperature_10th_c)
+{
+	const int16_t offset_10th_c = constrain(temperature_10th_c - table_min_10th_c, 0, (table_size - 1) * table_step_10th_c);
+	const uint8_t index = min(offset_10th_c / table_step_10th_c, table_size - 2);
+	const int16_t fraction_10th_c = offset_10th_c - index * table_step_10th_c;
+
+	const uint16_t lower = getTableEntry(index);
+	const uint16_t upper = getTableEntry(index + 1);
+
+	return lower + static_cast<uint32_t>(upper - lower) * fraction_10th_c / table_step_10th_c;
+}
+
+uint16_t Psychrometrics::getVapourPressurePa(int16_t temperature_10th_c, int16_t humidity_per_mill)
+{
+	return static_cast<uint32_t>(getSaturationPressurePa(temperature_10th_c)) * constrain(humidity_per_mill, 0, 1000) / 1000;
+}
+
+int16_t Psychrometrics::getDewPoint10thC(int16_t temperature_10th_c, int16_t humidity_per_mill)
+{
+	const uint16_t pressure_pa = getVapourPressurePa(temperature_10th_c, humidity_per_mill);
+
+	if (pressure_pa <= getFrostTableEntry(0)) {
+		return table_min_10th_c;
+	}
+
+	// The dew point is where this pressure is the saturation pressure,
+	// below 0 °C over ice as the floor frosts rather than fogs
+	uint8_t index = 0;
+	while (index < table_size - 2 && getFrostTableEntry(index + 1) < pressure_pa) {
+		++index;
+	}
+
+	const uint16_t lower = getFrostTableEntry(index);
+	const uint16_t upper = getFrostTableEntry(index + 1);
+
+	const int16_t dew_point_10th_c = table_min_10th_c + index * table_step_10th_c
+		+ static_cast<uint32_t>(pressure_pa - lower) * table_step_10th_c / (upper - lower);
+
+	return min(dew_point_10th_c, temperature_10th_c);
+}
+
+uint16_t Psychrometrics::getAbsoluteHumidity10thGPerM3(int16_t temperature_10th_c, int16_t humidity_per_mill)
+{
+	// ρ = e / (R_v · T) with R_v = 461.5 J/(kg·K)
+	const uint32_t temperature_10th_k = static_cast<int32_t>(temperature_10th_c) + 2732;
+
+	return static_cast<uint32_t>(getVapourPressurePa(temperature_10th_c, humidity_per_mill)) * 2167UL / (temperature_10th_k * 10UL);
+}
@@ -0,0 +1,38 @@
+/*
+	CavyCave - A temperature controlled box for guinea pigs and other
+		small animals kept outside in winter
+
+	Copyright (C) 2020-2021 Flössie <floessie.mail@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Moist air properties in fixed point, interpolated from a saturation
+// vapour pressure table instead of evaluating the Magnus formula
+namespace Psychrometrics
+{
+
+	// Over water, as relative humidity is measured against
+	uint16_t getSaturationPressurePa(int16_t temperature_10th_c);
+	uint16_t getVapourPressurePa(int16_t temperature_10th_c, int16_t humidity_per_mill);
+
+	// The frost point below 0 °C
+	int16_t getDewPoint10thC(int16_t temperature_10th_c, int16_t humidity_per_mill);
+	uint16_t getAbsoluteHumidity10thGPerM3(int16_t temperature_10th_c, int16_t humidity_per_mill);
+
+}
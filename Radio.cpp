@@ -30,6 +30,21 @@
 #include "Pins.hpp"
 #include "Stats.hpp"
 
+namespace
+{
+
+	// In case an edge was missed, the IRQ line stays low until cleared
+	constexpr uint32_t fallback_poll_ms = 1000;
+
+	volatile bool irq_pending = false;
+
+	// The top bits of the command byte carry a tag of the gateway's
+	// choice, echoed in the reply so it can be matched to its request
+	constexpr uint8_t tag_shift = 5;
+	constexpr uint8_t tag_mask = 0x07 << tag_shift;
+
+}
+
 class Radio::Implementation final
 {
 public:
@@ -40,7 +55,14 @@ public:
 		configuration{
 			110,
 			{'C', 'C', 'a', 'v', 'e'}
-		}
+		},
+		pending_configuration{},
+		pending_received{},
+		pending_active(false),
+		draining(false),
+		poll_timestamp(0),
+		irq_count(0),
+		flush_count(0)
 	{
 	}
 
@@ -61,6 +83,13 @@ public:
 
 		rf24.openReadingPipe(1, configuration.address);
 
+		// RX_DR, TX_DS and MAX_RT pull the IRQ line low, falling edge on INT0
+		rf24.maskIRQ(false, false, false);
+		pinMode(Pin::IRQ, INPUT);
+		EICRA = (EICRA & ~(_BV(ISC01) | _BV(ISC00))) | _BV(ISC01);
+		EIFR = _BV(INTF0);
+		EIMSK |= _BV(INT0);
+
 		rf24.startListening();
 	}
 
@@ -94,16 +123,51 @@ public:
 			SET_LED,
 			GET_STATS_MIN_MAX,
 			GET_STATS_DURATIONS,
-			RESET_STATS
+			RESET_STATS,
+			GET_SENSOR_HEALTH,
+			START_AUTOTUNE,
+			SET_HEATING,
+			SET_TIME,
+			GET_SCHEDULE,
+			SET_SCHEDULE_ENTRY,
+			GET_STATS_SHEDDING,
+			GET_ENERGY
 		};
 
+		static_assert(static_cast<uint8_t>(Command::GET_ENERGY) < 1 << tag_shift, "Commands overlap the tag");
+
+		// Only talk to the radio over SPI once it signalled, or while
+		// draining its FIFO
+		if (!draining) {
+			if (irq_pending) {
+				++irq_count;
+			}
+			else if (millis() - poll_timestamp < fallback_poll_ms) {
+				return false;
+			}
+
+			irq_pending = false;
+			poll_timestamp = millis();
+
+			// Releases the IRQ line for the next edge
+			bool tx_ok;
+			bool tx_fail;
+			bool rx_ready;
+			rf24.whatHappened(tx_ok, tx_fail, rx_ready);
+		}
+
 		bool again = false;
 
-		if (rf24.available() && rf24.getDynamicPayloadSize()) {
+		const uint8_t size = rf24.available() ? min(32, rf24.getDynamicPayloadSize()) : 0;
+
+		if (size) {
 			char buffer[32];
-			rf24.read(buffer, min(32, rf24.getDynamicPayloadSize()));
+			rf24.read(buffer, size);
+
+			const uint8_t tag = uint8_t(buffer[0]) & tag_mask;
+			const Command command = Command(uint8_t(buffer[0]) & ~tag_mask);
 
-			switch (Command(buffer[0])) {
+			switch (command) {
 				case Command::POLL: {
 					break;
 				}
@@ -114,43 +178,76 @@ public:
 						Controller::State state;
 					};
 
+					static_assert(sizeof(Reply) <= 32, "State exceeds one payload");
+
 					const Reply reply = {
 						Command::GET_STATE,
 						controller.getState()
 					};
 
-					delay(5);
-
-					rf24.flush_tx();
-					rf24.writeAckPayload(1, &reply, sizeof(reply));
+					queueReply(&reply, sizeof(reply), tag);
 
 					again = true;
 					break;
 				}
 
 				case Command::GET_CONFIG: {
+					// The configuration exceeds a payload and is transferred
+					// in chunks addressed by their offset
 					struct Reply {
 						Command command;
-						Controller::Configuration configuration;
+						uint8_t offset;
+						uint8_t data[30];
 					};
 
-					const Reply reply = {
-						Command::GET_CONFIG,
-						controller.getConfiguration()
-					};
+					const uint8_t offset = size > 1 ? buffer[1] : 0;
 
-					delay(5);
+					if (offset < sizeof(Controller::Configuration)) {
+						const uint8_t length = min(sizeof(Controller::Configuration) - offset, sizeof(Reply::data));
 
-					rf24.flush_tx();
-					rf24.writeAckPayload(1, &reply, sizeof(reply));
+						Reply reply;
+						reply.command = Command::GET_CONFIG;
+						reply.offset = offset;
+						memcpy(reply.data, reinterpret_cast<const uint8_t*>(&controller.getConfiguration()) + offset, length);
 
-					again = true;
+						queueReply(&reply, offsetof(Reply, data) + length, tag);
+
+						again = true;
+					}
 					break;
 				}
 
 				case Command::SET_CONFIG: {
-					if (rf24.getDynamicPayloadSize() - 1 == sizeof(Controller::Configuration)) {
-						controller.setConfiguration(*reinterpret_cast<Controller::Configuration*>(buffer + 1));
+					// Chunks are collected from the one at offset 0 on and
+					// applied once every byte arrived. If any went missing
+					// by the last chunk, the transfer is discarded.
+					static_assert(sizeof(Controller::Configuration) < 256, "Configuration exceeds one byte offsets");
+
+					if (size > 2) {
+						const uint8_t offset = buffer[1];
+						const uint8_t length = size - 2;
+
+						if (offset + length <= sizeof(Controller::Configuration)) {
+							if (!offset) {
+								memset(pending_received, 0, sizeof(pending_received));
+								pending_active = true;
+							}
+
+							if (pending_active) {
+								memcpy(reinterpret_cast<uint8_t*>(&pending_configuration) + offset, buffer + 2, length);
+								for (uint8_t i = offset; i < offset + length; ++i) {
+									pending_received[i / 8] |= 1U << i % 8;
+								}
+
+								if (isPendingConfigurationComplete()) {
+									controller.setConfiguration(pending_configuration);
+									pending_active = false;
+								}
+								else if (offset + length == sizeof(Controller::Configuration)) {
+									pending_active = false;
+								}
+							}
+						}
 					}
 					break;
 				}
@@ -161,28 +258,74 @@ public:
 				}
 
 				case Command::SET_FAN: {
-					if (rf24.getDynamicPayloadSize() > 1) {
+					if (size > 1) {
 						controller.setFanSpeed(Fan::Speed(buffer[1]));
 					}
 					break;
 				}
 
-				case Command::SET_LOUNGE: {
-					if (rf24.getDynamicPayloadSize() > 1) {
-						controller.setHeatingLounge(buffer[1]);
+				case Command::SET_LOUNGE:
+				case Command::SET_VESTIBULE: {
+					if (size > 1) {
+						controller.setHeating(
+							command == Command::SET_LOUNGE
+								? Controller::LOUNGE
+								: Controller::VESTIBULE,
+							buffer[1]
+						);
 					}
 					break;
 				}
 
-				case Command::SET_VESTIBULE: {
-					if (rf24.getDynamicPayloadSize() > 1) {
-						controller.setHeatingVestibule(buffer[1]);
+				case Command::SET_HEATING: {
+					if (size > 2 && uint8_t(buffer[1]) < Controller::ZONE_COUNT) {
+						controller.setHeating(buffer[1], buffer[2]);
+					}
+					break;
+				}
+
+				case Command::SET_TIME: {
+					// Seconds of the day
+					if (size >= 1 + sizeof(uint32_t)) {
+						uint32_t seconds;
+						memcpy(&seconds, buffer + 1, sizeof(seconds));
+						controller.setTime(seconds);
+					}
+					break;
+				}
+
+				case Command::GET_SCHEDULE: {
+					struct Reply {
+						Command command;
+						Schedule::Entry entries[Schedule::entry_count];
+					};
+
+					static_assert(sizeof(Reply) <= 32, "Schedule exceeds one payload");
+
+					Reply reply;
+					reply.command = Command::GET_SCHEDULE;
+					for (uint8_t i = 0; i < Schedule::entry_count; ++i) {
+						reply.entries[i] = controller.getSchedule().getEntry(i);
+					}
+
+					queueReply(&reply, sizeof(reply), tag);
+
+					again = true;
+					break;
+				}
+
+				case Command::SET_SCHEDULE_ENTRY: {
+					// Index followed by the entry
+					if (size >= 2 + sizeof(Schedule::Entry) && uint8_t(buffer[1]) < Schedule::entry_count) {
+						Schedule::Entry entry;
+						memcpy(&entry, buffer + 2, sizeof(entry));
+						controller.setScheduleEntry(buffer[1], entry);
 					}
 					break;
 				}
 
 				case Command::SET_LED: {
-					if (rf24.getDynamicPayloadSize() > 1) {
+					if (size > 1) {
 						controller.setLedColor(Led::Color(buffer[1]));
 					}
 					break;
@@ -200,6 +343,12 @@ public:
 
 						int16_t min_humidity_per_mill;
 						int16_t max_humidity_per_mill;
+
+						int16_t min_outdoor_temperature_10th_c;
+						int16_t max_outdoor_temperature_10th_c;
+
+						int16_t min_outdoor_humidity_per_mill;
+						int16_t max_outdoor_humidity_per_mill;
 					};
 
 					const Reply reply = {
@@ -209,13 +358,14 @@ public:
 						stats.getMinFloorTemperature10thC(),
 						stats.getMaxFloorTemperature10thC(),
 						stats.getMinHumidityPerMill(),
-						stats.getMaxHumidityPerMill()
+						stats.getMaxHumidityPerMill(),
+						stats.getMinOutdoorTemperature10thC(),
+						stats.getMaxOutdoorTemperature10thC(),
+						stats.getMinOutdoorHumidityPerMill(),
+						stats.getMaxOutdoorHumidityPerMill()
 					};
 
-					delay(5);
-
-					rf24.flush_tx();
-					rf24.writeAckPayload(1, &reply, sizeof(reply));
+					queueReply(&reply, sizeof(reply), tag);
 
 					again = true;
 					break;
@@ -227,33 +377,72 @@ public:
 
 						uint32_t seconds_since_reset;
 
-						uint16_t lounge_heating_count;
-						uint32_t lounge_heating_seconds;
-
-						uint16_t vestibule_heating_count;
-						uint32_t vestibule_heating_seconds;
+						struct {
+							uint16_t count;
+							uint32_t seconds;
+						} heating[Controller::ZONE_COUNT];
 
 						uint16_t fan_count;
 						uint32_t fan_low_seconds;
 						uint32_t fan_high_seconds;
 					};
 
-					const Reply reply = {
-						Command::GET_STATS_DURATIONS,
-						stats.getSecondsSinceReset(),
-						stats.getLoungeHeatingCount(),
-						stats.getLoungeHeatingSeconds(),
-						stats.getVestibuleHeatingCount(),
-						stats.getVestibuleHeatingSeconds(),
-						stats.getFanCount(),
-						stats.getFanLowSeconds(),
-						stats.getFanHighSeconds()
+					static_assert(sizeof(Reply) <= 32, "Too many zones for one payload");
+
+					Reply reply;
+					reply.command = Command::GET_STATS_DURATIONS;
+					reply.seconds_since_reset = stats.getSecondsSinceReset();
+					for (uint8_t zone = 0; zone < Controller::ZONE_COUNT; ++zone) {
+						reply.heating[zone].count = stats.getHeatingCount(zone);
+						reply.heating[zone].seconds = stats.getHeatingSeconds(zone);
+					}
+					reply.fan_count = stats.getFanCount();
+					reply.fan_low_seconds = stats.getFanLowSeconds();
+					reply.fan_high_seconds = stats.getFanHighSeconds();
+
+					queueReply(&reply, sizeof(reply), tag);
+
+					again = true;
+					break;
+				}
+
+				case Command::GET_STATS_SHEDDING: {
+					struct Reply {
+						Command command;
+
+						struct {
+							uint16_t count;
+							uint32_t seconds;
+						} shed[Controller::ZONE_COUNT];
 					};
 
-					delay(5);
+					static_assert(sizeof(Reply) <= 32, "Too many zones for one payload");
 
-					rf24.flush_tx();
-					rf24.writeAckPayload(1, &reply, sizeof(reply));
+					Reply reply;
+					reply.command = Command::GET_STATS_SHEDDING;
+					for (uint8_t zone = 0; zone < Controller::ZONE_COUNT; ++zone) {
+						reply.shed[zone].count = stats.getShedCount(zone);
+						reply.shed[zone].seconds = stats.getShedSeconds(zone);
+					}
+
+					queueReply(&reply, sizeof(reply), tag);
+
+					again = true;
+					break;
+				}
+
+				case Command::GET_ENERGY: {
+					struct Reply {
+						Command command;
+						Controller::Energy energy;
+					};
+
+					const Reply reply = {
+						Command::GET_ENERGY,
+						controller.getEnergy()
+					};
+
+					queueReply(&reply, sizeof(reply), tag);
 
 					again = true;
 					break;
@@ -263,9 +452,40 @@ public:
 					stats.reset();
 					break;
 				}
+
+				case Command::GET_SENSOR_HEALTH: {
+					if (size > 1 && uint8_t(buffer[1]) < Sensors::SENSOR_COUNT) {
+						struct Reply {
+							Command command;
+							uint8_t sensor;
+							Sensors::Health health;
+						};
+
+						const Reply reply = {
+							Command::GET_SENSOR_HEALTH,
+							uint8_t(buffer[1]),
+							controller.getSensors().getHealth(buffer[1])
+						};
+
+						queueReply(&reply, sizeof(reply), tag);
+
+						again = true;
+					}
+					break;
+				}
+
+				case Command::START_AUTOTUNE: {
+					if (size > 1 && uint8_t(buffer[1]) < Controller::ZONE_COUNT) {
+						controller.startAutotune(buffer[1]);
+					}
+					break;
+				}
 			}
 		}
 
+		// More may have arrived before the flags were cleared
+		draining = size != 0;
+
 		return again;
 	}
 
@@ -308,9 +528,41 @@ public:
 			Serial.print(configuration.address[i], HEX);
 		}
 		Serial.println();
+
+		Serial.print(F("  Interrupts: "));
+		Serial.println(irq_count);
+
+		Serial.print(F("  Uncollected reply flushes: "));
+		Serial.println(flush_count);
 	}
 
 private:
+	bool isPendingConfigurationComplete() const
+	{
+		for (uint8_t i = 0; i < sizeof(Controller::Configuration); ++i) {
+			if (!(pending_received[i / 8] & 1U << i % 8)) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Replies ride on the acks of the following packets, up to three can
+	// be queued. A full FIFO means nobody collected them, so they're stale.
+	void queueReply(const void* reply, uint8_t length, uint8_t tag)
+	{
+		uint8_t payload[32];
+		memcpy(payload, reply, length);
+		payload[0] |= tag;
+
+		if (!rf24.writeAckPayload(1, payload, length)) {
+			rf24.flush_tx();
+			rf24.writeAckPayload(1, payload, length);
+			++flush_count;
+		}
+	}
+
 	void loadConfiguration()
 	{
 		if (EEPROM.read(256) != 0xFF) {
@@ -329,8 +581,22 @@ private:
 	Stats& stats;
 
 	Configuration configuration;
+
+	Controller::Configuration pending_configuration;
+	uint8_t pending_received[(sizeof(Controller::Configuration) + 7) / 8];
+	bool pending_active;
+
+	bool draining;
+	uint32_t poll_timestamp;
+	uint16_t irq_count;
+	uint16_t flush_count;
 };
 
+ISR(INT0_vect)
+{
+	irq_pending = true;
+}
+
 Radio::Radio(Controller& _controller, Stats& _stats) :
 	implementation(new Implementation(_controller, _stats))
 {
@@ -0,0 +1,205 @@
+/*
+	CavyCave - A temperature controlled box for guinea pigs and other
+		small animals kept outside in winter
+
+	Copyright (C) 2020-2021 Flössie <floessie.mail@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <Arduino.h>
+#include <EEPROM.h>
+
+#include "Schedule.hpp"
+
+namespace
+{
+
+	constexpr uint16_t minutes_per_day = 24U * 60U;
+
+	constexpr int eeprom_offset = 512;
+
+	// Distance from a to b going forward around midnight
+	constexpr uint16_t minutesAfter(uint16_t a, uint16_t b)
+	{
+		return (b + minutes_per_day - a) % minutes_per_day;
+	}
+
+	void print02(uint16_t value)
+	{
+		if (value < 10) {
+			Serial.print(F("0"));
+		}
+		Serial.print(value);
+	}
+
+}
+
+Schedule::Schedule() :
+	entries{},
+	active_profile(no_profile),
+	next_index(0),
+	last_minute(0),
+	synced(false)
+{
+}
+
+void Schedule::begin()
+{
+	loadEntries();
+}
+
+bool Schedule::run(bool clock_set, uint16_t minute_of_day)
+{
+	const uint8_t previous_profile = active_profile;
+
+	if (!clock_set) {
+		active_profile = no_profile;
+		synced = false;
+	}
+	else if (!synced) {
+		resync(minute_of_day);
+		synced = true;
+	}
+	else if (minute_of_day != last_minute) {
+		// Only the next entry is looked at, it fires once the clock
+		// passed it since the last call
+		const uint8_t used_count = getUsedCount();
+
+		for (uint8_t i = 0; i < used_count; ++i) {
+			const Entry& entry = entries[next_index];
+
+			if (
+				!minutesAfter(last_minute, entry.minute_of_day)
+				|| minutesAfter(last_minute, entry.minute_of_day) > minutesAfter(last_minute, minute_of_day)
+			) {
+				break;
+			}
+
+			active_profile = entry.profile;
+			next_index = (next_index + 1) % used_count;
+		}
+
+		last_minute = minute_of_day;
+	}
+
+	return active_profile != previous_profile;
+}
+
+void Schedule::invalidate()
+{
+	synced = false;
+}
+
+uint8_t Schedule::getActiveProfile() const
+{
+	return active_profile;
+}
+
+Schedule::Entry Schedule::getEntry(uint8_t index) const
+{
+	return entries[index];
+}
+
+void Schedule::setEntry(uint8_t index, const Entry& value)
+{
+	entries[index] = value;
+	sort();
+	saveEntries();
+	synced = false;
+}
+
+void Schedule::dump() const
+{
+	Serial.println(F("Schedule:"));
+
+	const uint8_t used_count = getUsedCount();
+
+	if (!used_count) {
+		Serial.println(F("  Empty"));
+	}
+
+	for (uint8_t i = 0; i < used_count; ++i) {
+		Serial.print(F("  "));
+		print02(entries[i].minute_of_day / 60);
+		Serial.print(F(":"));
+		print02(entries[i].minute_of_day % 60);
+		Serial.print(F(" profile "));
+		Serial.println(entries[i].profile);
+	}
+}
+
+uint8_t Schedule::getUsedCount() const
+{
+	uint8_t result = 0;
+
+	while (result < entry_count && entries[result].minute_of_day != unused) {
+		++result;
+	}
+
+	return result;
+}
+
+void Schedule::sort()
+{
+	// Invalid entries become unused, which sort last
+	for (uint8_t i = 0; i < entry_count; ++i) {
+		if (entries[i].minute_of_day >= minutes_per_day || entries[i].profile >= profile_count) {
+			entries[i] = {unused, no_profile};
+		}
+	}
+
+	for (uint8_t i = 1; i < entry_count; ++i) {
+		const Entry entry = entries[i];
+		uint8_t j = i;
+
+		for (; j && entries[j - 1].minute_of_day > entry.minute_of_day; --j) {
+			entries[j] = entries[j - 1];
+		}
+
+		entries[j] = entry;
+	}
+}
+
+void Schedule::resync(uint16_t minute_of_day)
+{
+	const uint8_t used_count = getUsedCount();
+
+	active_profile = no_profile;
+	next_index = 0;
+	last_minute = minute_of_day;
+
+	if (!used_count) {
+		return;
+	}
+
+	// The last entry not after now is active, before the first one of
+	// the day the last one of the previous day still is
+	uint8_t i = 0;
+	for (; i < used_count && entries[i].minute_of_day <= minute_of_day; ++i);
+
+	active_profile = entries[i ? i - 1 : used_count - 1].profile;
+	next_index = i % used_count;
+}
+
+void Schedule::loadEntries()
+{
+	EEPROM.get(eeprom_offset, entries);
+	sort();
+}
+
+void Schedule::saveEntries()
+{
+	EEPROM.put(eeprom_offset, entries);
+}
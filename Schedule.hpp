@@ -0,0 +1,71 @@
+/*
+	CavyCave - A temperature controlled box for guinea pigs and other
+		small animals kept outside in winter
+
+	Copyright (C) 2020-2021 Flössie <floessie.mail@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// Switches between setpoint profiles at given minutes of the day. The
+// entries live in EEPROM and are kept sorted by time, unused ones last.
+class Schedule final
+{
+public:
+	static constexpr uint8_t entry_count = 8;
+	static constexpr uint8_t profile_count = 3;
+	static constexpr uint16_t unused = 0xFFFF;
+	static constexpr uint8_t no_profile = 0xFF;
+
+	struct Entry {
+		uint16_t minute_of_day;
+		uint8_t profile;
+	};
+
+	Schedule();
+
+	void begin();
+
+	// Returns true if the active profile changed
+	bool run(bool clock_set, uint16_t minute_of_day);
+
+	// To be called after the clock jumped
+	void invalidate();
+
+	uint8_t getActiveProfile() const;
+
+	Entry getEntry(uint8_t index) const;
+	void setEntry(uint8_t index, const Entry& value);
+
+	void dump() const;
+
+private:
+	uint8_t getUsedCount() const;
+	void sort();
+	void resync(uint16_t minute_of_day);
+
+	void loadEntries();
+	void saveEntries();
+
+	Entry entries[entry_count];
+
+	uint8_t active_profile;
+	uint8_t next_index;
+	uint16_t last_minute;
+	bool synced;
+};
@@ -0,0 +1,168 @@
+/*
+	CavyCave - A temperature controlled box for guinea pigs and other
+		small animals kept outside in winter
+
+	Copyright (C) 2020-2021 Flössie <floessie.mail@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <Arduino.h>
+#include <avr/sleep.h>
+
+#include "Scheduler.hpp"
+
+namespace
+{
+
+	constexpr uint32_t sleep_window_ms = 10000;
+
+	constexpr bool isDue(uint32_t now, uint32_t deadline)
+	{
+		return static_cast<int32_t>(now - deadline) >= 0;
+	}
+
+}
+
+Scheduler::Scheduler() :
+	tasks{},
+	task_count(0),
+	sleep_micros(0),
+	sleep_window_timestamp(0),
+	sleep_per_mill(0)
+{
+}
+
+void Scheduler::add(const __FlashStringHelper* name, Function function, uint32_t period_ms, uint16_t budget_micros)
+{
+	if (task_count == max_task_count) {
+		return;
+	}
+
+	Task& task = tasks[task_count++];
+
+	task.name = name;
+	task.function = function;
+	task.period_ms = period_ms;
+	task.deadline = millis() + period_ms;
+	task.budget_micros = budget_micros;
+}
+
+bool Scheduler::run()
+{
+	const uint32_t now = millis();
+
+	// With this few tasks a scan is cheaper than keeping a heap
+	Task* next = nullptr;
+	for (uint8_t i = 0; i < task_count; ++i) {
+		Task& task = tasks[i];
+
+		if (isDue(now, task.deadline) && (!next || static_cast<int32_t>(task.deadline - next->deadline) < 0)) {
+			next = &task;
+		}
+	}
+
+	if (!next) {
+		return false;
+	}
+
+	const uint32_t start_micros = micros();
+	next->function();
+	const uint16_t duration_micros = min(micros() - start_micros, 0xFFFFUL);
+
+	next->max_micros = max(next->max_micros, duration_micros);
+	if (duration_micros > next->budget_micros) {
+		++next->overrun_count;
+	}
+
+	next->deadline += next->period_ms;
+
+	// Drop whole periods when far behind instead of running back to back
+	if (isDue(now, next->deadline)) {
+		const uint32_t missed = (now - next->deadline) / next->period_ms + 1;
+
+		next->deadline += missed * next->period_ms;
+		next->missed_count += missed;
+	}
+
+	return true;
+}
+
+uint32_t Scheduler::getIdleMillis() const
+{
+	const uint32_t now = millis();
+
+	uint32_t idle_ms = UINT32_MAX;
+	for (uint8_t i = 0; i < task_count; ++i) {
+		if (isDue(now, tasks[i].deadline)) {
+			return 0;
+		}
+		idle_ms = min(idle_ms, tasks[i].deadline - now);
+	}
+
+	return idle_ms;
+}
+
+void Scheduler::sleep()
+{
+	const uint32_t elapsed_ms = millis() - sleep_window_timestamp;
+
+	if (elapsed_ms >= sleep_window_ms) {
+		sleep_per_mill = min(sleep_micros / elapsed_ms, 1000UL);
+		sleep_micros = 0;
+		sleep_window_timestamp = millis();
+	}
+
+	if (!getIdleMillis()) {
+		return;
+	}
+
+	// Power-save would stop Timer0 and Timer1, taking millis() and the
+	// fan PWM with them. Idle keeps all clocks running and wakes on any
+	// interrupt: the Timer0 tick, UART RX or the radio on INT0.
+	const uint32_t start_micros = micros();
+
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_mode();
+
+	sleep_micros += micros() - start_micros;
+}
+
+void Scheduler::dump() const
+{
+	Serial.println(F("Tasks:"));
+	for (uint8_t i = 0; i < task_count; ++i) {
+		const Task& task = tasks[i];
+
+		Serial.print(F("  "));
+		Serial.print(task.name);
+		Serial.print(F(": every "));
+		Serial.print(task.period_ms);
+		Serial.print(F(" ms, max "));
+		Serial.print(task.max_micros);
+		Serial.print(F(" of "));
+		Serial.print(task.budget_micros);
+		Serial.print(F(" µs, "));
+		Serial.print(task.overrun_count);
+		Serial.print(F(" overruns, "));
+		Serial.print(task.missed_count);
+		Serial.println(F(" missed"));
+	}
+
+	Serial.print(F("  Asleep: "));
+	Serial.print(sleep_per_mill / 10);
+	Serial.print(F("."));
+	Serial.print(sleep_per_mill % 10);
+	Serial.println(F("%"));
+}
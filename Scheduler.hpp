@@ -0,0 +1,70 @@
+/*
+	CavyCave - A temperature controlled box for guinea pigs and other
+		small animals kept outside in winter
+
+	Copyright (C) 2020-2021 Flössie <floessie.mail@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+class __FlashStringHelper;
+
+// Runs periodic tasks cooperatively, earliest deadline first. Deadlines
+// advance by whole periods, so a late run doesn't shift later ones.
+class Scheduler final
+{
+public:
+	using Function = void (*)();
+
+	static constexpr uint8_t max_task_count = 6;
+
+	Scheduler();
+
+	// A run taking longer than budget_micros is counted as an overrun
+	void add(const __FlashStringHelper* name, Function function, uint32_t period_ms, uint16_t budget_micros);
+
+	// Runs one due task, returns false if none was due
+	bool run();
+
+	// Time until the next deadline, 0 if a task is due
+	uint32_t getIdleMillis() const;
+
+	// Idles the CPU until the next interrupt if no task is due
+	void sleep();
+
+	void dump() const;
+
+private:
+	struct Task {
+		const __FlashStringHelper* name;
+		Function function;
+		uint32_t period_ms;
+		uint32_t deadline;
+		uint16_t budget_micros;
+		uint16_t max_micros;
+		uint16_t overrun_count;
+		uint16_t missed_count;
+	};
+
+	Task tasks[max_task_count];
+	uint8_t task_count;
+
+	uint32_t sleep_micros;
+	uint32_t sleep_window_timestamp;
+	uint16_t sleep_per_mill;
+};
@@ -20,117 +20,778 @@
 
 #include <Arduino.h>
 
-#include <TroykaDHT.h>
-
-#include <OneWire.h>
-#define REQUIRESALARMS false
-#include <DallasTemperature.h>
-
 #include "Sensors.hpp"
 
+#include "Dht22.hpp"
+#include "Ds18b20.hpp"
 #include "Pins.hpp"
 
 namespace
 {
 
+	constexpr uint8_t channel_count = 2;
+
+	// Sensors never seen are only looked for every so many rounds
+	constexpr uint8_t absent_probe_rounds = 30;
+
 	constexpr bool timeAfter(uint32_t a, uint32_t b)
 	{
 		return static_cast<int32_t>(b - a) < 0;
 	}
 
+	// Average both readings if they agree, otherwise trust the one closer
+	// to the previous result
+	int16_t vote(int16_t a, int16_t b, int16_t previous, int16_t tolerance)
+	{
+		if (abs(a - b) <= tolerance) {
+			return (a + b) / 2;
+		}
+
+		return abs(a - previous) <= abs(b - previous) ? a : b;
+	}
+
+	// Health counters stick at their maximum instead of wrapping
+	template<typename T>
+	void saturatingIncrement(T& value)
+	{
+		if (value != static_cast<T>(~static_cast<T>(0))) {
+			++value;
+		}
+	}
+
+	// Median of the last samples to reject spikes, followed by an
+	// exponential moving average kept in 1/16 of the input unit
+	class Filter final
+	{
+	public:
+		Filter() :
+			samples{},
+			count(0),
+			next(0),
+			length(1),
+			shift(0),
+			average_16th(0)
+		{
+		}
+
+		void configure(uint8_t median_length, uint8_t ewma_shift)
+		{
+			length = constrain(median_length, 1, Sensors::max_filter_median_length);
+			shift = min(ewma_shift, Sensors::max_filter_ewma_shift);
+			reset();
+		}
+
+		void reset()
+		{
+			count = 0;
+			next = 0;
+		}
+
+		int16_t add(int16_t value)
+		{
+			samples[next] = value;
+			next = (next + 1) % length;
+			if (count < length) {
+				++count;
+			}
+
+			int16_t sorted[Sensors::max_filter_median_length];
+			for (uint8_t i = 0; i < count; ++i) {
+				uint8_t j = i;
+				for (; j && sorted[j - 1] > samples[i]; --j) {
+					sorted[j] = sorted[j - 1];
+				}
+				sorted[j] = samples[i];
+			}
+
+			const int32_t median_16th = static_cast<int32_t>(sorted[count / 2]) * 16;
+
+			if (count == 1) {
+				average_16th = median_16th;
+			} else {
+				average_16th += (median_16th - average_16th) >> shift;
+			}
+
+			return (average_16th + 8) >> 4;
+		}
+
+	private:
+		int16_t samples[Sensors::max_filter_median_length];
+		uint8_t count;
+		uint8_t next;
+		uint8_t length;
+		uint8_t shift;
+		int32_t average_16th;
+	};
+
+	// Power cycles the supply line shared by the sensors of a kind and
+	// keeps failing sensors off the bus for an exponentially growing time
+	class Recovery final
+	{
+	public:
+		explicit Recovery(uint8_t _power_pin) :
+			power_pin(_power_pin),
+			state(State::POWERED),
+			timestamp(0),
+			cycle_requests(0),
+			backoff{},
+			backoff_exponent{},
+			backoff_timestamp{}
+		{
+			pinMode(power_pin, OUTPUT);
+			digitalWrite(power_pin, true);
+		}
+
+		bool isBusAllowed(uint8_t channel) const
+		{
+			return state == State::POWERED && !backoff[channel];
+		}
+
+		void onFailure(uint8_t channel)
+		{
+			backoff[channel] = true;
+			backoff_timestamp[channel] = millis() + (backoff_base_ms << backoff_exponent[channel]);
+			if (backoff_exponent[channel] < max_backoff_exponent) {
+				++backoff_exponent[channel];
+			}
+
+			// Failures while the line is cycled don't ask for another
+			if (state == State::POWERED) {
+				cycle_requests |= 1U << channel;
+			}
+		}
+
+		// Called between reads, returns the channels that asked for the
+		// supply line to be switched off if it was, 0 otherwise
+		uint8_t startCycle()
+		{
+			if (!cycle_requests || state != State::POWERED) {
+				return 0;
+			}
+
+			const uint8_t requests = cycle_requests;
+			cycle_requests = 0;
+
+			digitalWrite(power_pin, false);
+			state = State::OFF;
+			timestamp = millis() + power_off_ms;
+
+			return requests;
+		}
+
+		void onSuccess(uint8_t channel)
+		{
+			backoff_exponent[channel] = 0;
+		}
+
+		void run()
+		{
+			switch (state) {
+				case State::POWERED: {
+					break;
+				}
+
+				case State::OFF: {
+					if (timeAfter(millis(), timestamp)) {
+						digitalWrite(power_pin, true);
+						state = State::SETTLING;
+						timestamp = millis() + settle_ms;
+					}
+					break;
+				}
+
+				case State::SETTLING: {
+					if (timeAfter(millis(), timestamp)) {
+						state = State::POWERED;
+					}
+					break;
+				}
+			}
+
+			for (uint8_t i = 0; i < channel_count; ++i) {
+				if (backoff[i] && timeAfter(millis(), backoff_timestamp[i])) {
+					backoff[i] = false;
+				}
+			}
+		}
+
+	private:
+		enum class State : uint8_t {
+			POWERED,
+			OFF,
+			SETTLING
+		};
+
+		static constexpr uint32_t power_off_ms = 1000;
+		static constexpr uint32_t settle_ms = 2000;
+		static constexpr uint32_t backoff_base_ms = 10000;
+		static constexpr uint8_t max_backoff_exponent = 6;
+
+		const uint8_t power_pin;
+
+		State state;
+		uint32_t timestamp;
+		uint8_t cycle_requests;
+
+		bool backoff[channel_count];
+		uint8_t backoff_exponent[channel_count];
+		uint32_t backoff_timestamp[channel_count];
+	};
+
 }
 
 class Sensors::Implementation final
 {
 public:
 	Implementation() :
-		dht22(Pin::DHT_A, DHT22),
+		dht22{Dht22(Pin::DHT_A), Dht22(Pin::DHT_B)},
 		dht22_next_update_timestamp(0),
-		dht22_consecutive_errors(0),
-		one_wire(Pin::DS_A),
-		temperature_sensors(&one_wire),
-		ds18b20_last_value(20),
-		ds18b20_consecutive_errors(0)
+		dht22_consecutive_errors{},
+		dht22_present{true, false},
+		dht22_round_pending(false),
+		dht22_fresh{},
+		temperature_10th_c(0),
+		humidity_per_mill(0),
+		room_values_read(false),
+		outdoor_probe(false),
+		outdoor_temperature_10th_c(0),
+		outdoor_humidity_per_mill(0),
+		ds18b20{Ds18b20(Pin::DS_A), Ds18b20(Pin::DS_B)},
+		ds18b20_next_update_timestamp(0),
+		ds18b20_consecutive_errors{},
+		ds18b20_present{true, false},
+		ds18b20_round_pending(false),
+		ds18b20_fresh{},
+		floor_temperature_10th_c(20),
+		floor_value_read(false),
+		floor_resolution(12),
+		min_floor_temperature_10th_c(INT16_MIN),
+		max_floor_temperature_10th_c(INT16_MAX),
+		dht22_recovery(Pin::DHT_PWR),
+		ds18b20_recovery(Pin::DS_PWR),
+		health{},
+		total_read_micros{},
+		timed_reads{},
+		dht22_probe_countdown(0),
+		ds18b20_probe_countdown(0)
 	{
-		pinMode(Pin::DHT_PWR, OUTPUT);
-		digitalWrite(Pin::DHT_PWR, true);
-		pinMode(Pin::DS_PWR, OUTPUT);
-		digitalWrite(Pin::DS_PWR, true);
 	}
 
 	void begin()
 	{
-		dht22.begin();
+		for (uint8_t i = 0; i < channel_count; ++i) {
+			dht22[i].begin();
+			ds18b20[i].begin();
+		}
+	}
+
+	void run()
+	{
+		dht22_recovery.run();
+		ds18b20_recovery.run();
+
+		updateDht22();
+		updateDs18b20();
 	}
 
 	bool areRoomValuesValid() const
 	{
-		return dht22_consecutive_errors < 5;
+		return isDht22Valid(0) || (!outdoor_probe && isDht22Valid(1));
 	}
 
-	int16_t getTemperature10thC()
+	bool areRoomValuesRead() const
 	{
-		updateDht22();
-		return dht22.getTemperatureC() * 10;
+		return room_values_read;
 	}
 
-	int16_t getHumidityPerMill()
+	int16_t getTemperature10thC() const
 	{
-		updateDht22();
-		return dht22.getHumidity() * 10;
+		return temperature_10th_c;
+	}
+
+	int16_t getHumidityPerMill() const
+	{
+		return humidity_per_mill;
 	}
 
 	bool isFloorValueValid() const
 	{
-		return ds18b20_consecutive_errors < 5;
+		return isDs18b20Valid(0) || isDs18b20Valid(1);
 	}
 
-	int16_t getFloorTemperature10thC()
+	bool isFloorValueRead() const
 	{
-		if (temperature_sensors.requestTemperaturesByIndex(0)) {
-			ds18b20_last_value = temperature_sensors.getTempCByIndex(0) * 10;
-			ds18b20_consecutive_errors = 0;
-		} else {
-			++ds18b20_consecutive_errors;
+		return floor_value_read;
+	}
 
-			if (!ds18b20_consecutive_errors) {
-				++ds18b20_consecutive_errors;
-			}
+	int16_t getFloorTemperature10thC() const
+	{
+		return floor_temperature_10th_c;
+	}
+
+	uint8_t getFloorResolution() const
+	{
+		return floor_resolution;
+	}
 
-			digitalWrite(Pin::DS_PWR, static_cast<bool>(ds18b20_consecutive_errors % 5));
+	uint8_t getActiveFloorResolution() const
+	{
+		return ds18b20[isDs18b20Valid(0) ? 0 : 1].getResolution();
+	}
+
+	bool isOutdoorValueValid() const
+	{
+		return outdoor_probe && isDht22Valid(1);
+	}
+
+	int16_t getOutdoorTemperature10thC() const
+	{
+		return outdoor_temperature_10th_c;
+	}
+
+	int16_t getOutdoorHumidityPerMill() const
+	{
+		return outdoor_humidity_per_mill;
+	}
+
+	void setFloorThresholds(int16_t min_10th_c, int16_t max_10th_c)
+	{
+		min_floor_temperature_10th_c = min_10th_c;
+		max_floor_temperature_10th_c = max_10th_c;
+		updateFloorResolution();
+	}
+
+	void setOutdoorProbe(bool enabled)
+	{
+		if (enabled != outdoor_probe) {
+			outdoor_probe = enabled;
+			temperature_filter.reset();
+			humidity_filter.reset();
+			outdoor_temperature_filter.reset();
+			outdoor_humidity_filter.reset();
 		}
+	}
 
-		return ds18b20_last_value;
+	void setFilter(uint8_t median_length, uint8_t ewma_shift)
+	{
+		temperature_filter.configure(median_length, ewma_shift);
+		humidity_filter.configure(median_length, ewma_shift);
+		outdoor_temperature_filter.configure(median_length, ewma_shift);
+		outdoor_humidity_filter.configure(median_length, ewma_shift);
+		floor_temperature_filter.configure(median_length, ewma_shift);
+	}
+
+	Health getHealth(uint8_t sensor) const
+	{
+		Health result = health[sensor];
+
+		result.avg_read_micros = timed_reads[sensor] ? total_read_micros[sensor] / timed_reads[sensor] : 0;
+
+		return result;
+	}
+
+	void dump() const
+	{
+		Serial.println(F("Sensor health:"));
+
+		for (uint8_t i = 0; i < SENSOR_COUNT; ++i) {
+			switch (i) {
+				case DHT22_A: {
+					Serial.println(F("  DHT22 A:"));
+					break;
+				}
+
+				case DHT22_B: {
+					if (outdoor_probe) {
+						Serial.println(F("  DHT22 B (outdoor):"));
+					} else {
+						Serial.println(F("  DHT22 B:"));
+					}
+					break;
+				}
+
+				case DS18B20_A: {
+					Serial.println(F("  DS18B20 A:"));
+					break;
+				}
+
+				case DS18B20_B: {
+					Serial.println(F("  DS18B20 B:"));
+					break;
+				}
+			}
+
+			const Health h = getHealth(i);
+
+			Serial.print(F("    Reads: "));
+			Serial.println(h.reads);
+			Serial.print(F("    Checksum errors: "));
+			Serial.println(h.checksum_errors);
+			Serial.print(F("    Timeouts: "));
+			Serial.println(h.timeouts);
+			Serial.print(F("    Power cycles: "));
+			Serial.println(h.power_cycles);
+			Serial.print(F("    Read duration min/avg/max: "));
+			Serial.print(h.min_read_micros);
+			Serial.print(F("/"));
+			Serial.print(h.avg_read_micros);
+			Serial.print(F("/"));
+			Serial.print(h.max_read_micros);
+			Serial.println(F(" µs"));
+		}
 	}
 
 private:
+	// The second sensor of each kind is optional and only taken into
+	// account once it delivered a reading
+	bool isDht22Valid(uint8_t index) const
+	{
+		return dht22_present[index] && dht22_consecutive_errors[index] < 5;
+	}
+
+	bool isDs18b20Valid(uint8_t index) const
+	{
+		return ds18b20_present[index] && ds18b20_consecutive_errors[index] < 5;
+	}
+
+	// Valid and read fine this round, a sensor still within its error
+	// allowance would otherwise contribute its last good, stale value
+	bool isDht22Fresh(uint8_t index) const
+	{
+		return isDht22Valid(index) && dht22_fresh[index];
+	}
+
+	bool isDs18b20Fresh(uint8_t index) const
+	{
+		return isDs18b20Valid(index) && ds18b20_fresh[index];
+	}
+
 	void updateDht22()
 	{
 		if (timeAfter(millis(), dht22_next_update_timestamp)) {
-			if (dht22.read() == DHT_OK) {
-				dht22_consecutive_errors = 0;
-			} else {
-				++dht22_consecutive_errors;
+			const bool probe = isProbeRound(dht22_probe_countdown);
 
-				if (!dht22_consecutive_errors) {
-					++dht22_consecutive_errors;
+			for (uint8_t i = 0; i < channel_count; ++i) {
+				dht22_fresh[i] = false;
+				if (dht22_recovery.isBusAllowed(i) && (dht22_present[i] || probe)) {
+					dht22[i].start();
 				}
+			}
+			dht22_next_update_timestamp = millis() + 2000U;
+		}
 
-				digitalWrite(Pin::DHT_PWR, static_cast<bool>(dht22_consecutive_errors % 5));
+		for (uint8_t i = 0; i < channel_count; ++i) {
+			const Dht22::Result result = dht22[i].run();
+
+			switch (result) {
+				case Dht22::Result::NONE: {
+					break;
+				}
+
+				case Dht22::Result::OK: {
+					dht22_consecutive_errors[i] = 0;
+					dht22_present[i] = true;
+					dht22_fresh[i] = true;
+					dht22_recovery.onSuccess(i);
+					break;
+				}
+
+				case Dht22::Result::CHECKSUM_ERROR:
+				case Dht22::Result::TIMEOUT: {
+					onDht22Error(i);
+					break;
+				}
 			}
 
-			dht22_next_update_timestamp = millis() + 2000U;
+			if (result != Dht22::Result::NONE) {
+				if (dht22_present[i]) {
+					recordRead(
+						DHT22_A + i,
+						result == Dht22::Result::TIMEOUT,
+						result == Dht22::Result::CHECKSUM_ERROR,
+						dht22[i].getReadMicros()
+					);
+				}
+				dht22_round_pending = true;
+			}
+		}
+
+		// Combine once per round, after all sensors are done
+		if (dht22_round_pending && !dht22[0].isBusy() && !dht22[1].isBusy()) {
+			dht22_round_pending = false;
+
+			if (outdoor_probe) {
+				if (isDht22Fresh(1)) {
+					outdoor_temperature_10th_c = outdoor_temperature_filter.add(dht22[1].getTemperature10thC());
+					outdoor_humidity_per_mill = outdoor_humidity_filter.add(dht22[1].getHumidityPerMill());
+				}
+				else if (!isDht22Valid(1)) {
+					outdoor_temperature_filter.reset();
+					outdoor_humidity_filter.reset();
+				}
+			}
+
+			// A sensor that failed this round sits out, the value is held
+			// while no sensor read fine but none has dropped out yet
+			const bool fresh_a = isDht22Fresh(0);
+			const bool fresh_b = !outdoor_probe && isDht22Fresh(1);
+
+			if (fresh_a && fresh_b) {
+				temperature_10th_c = temperature_filter.add(vote(dht22[0].getTemperature10thC(), dht22[1].getTemperature10thC(), temperature_10th_c, 10));
+				humidity_per_mill = humidity_filter.add(vote(dht22[0].getHumidityPerMill(), dht22[1].getHumidityPerMill(), humidity_per_mill, 50));
+				room_values_read = true;
+			}
+			else if (fresh_a || fresh_b) {
+				const uint8_t i = fresh_a ? 0 : 1;
+				temperature_10th_c = temperature_filter.add(dht22[i].getTemperature10thC());
+				humidity_per_mill = humidity_filter.add(dht22[i].getHumidityPerMill());
+				room_values_read = true;
+			}
+			else if (!areRoomValuesValid()) {
+				temperature_filter.reset();
+				humidity_filter.reset();
+			}
+
+			countPowerCycles(DHT22_A, dht22_recovery.startCycle());
 		}
 	}
 
-	DHT dht22;
-	uint32_t dht22_next_update_timestamp;
-	uint16_t dht22_consecutive_errors;
+	void updateDs18b20()
+	{
+		if (timeAfter(millis(), ds18b20_next_update_timestamp)) {
+			const bool probe = isProbeRound(ds18b20_probe_countdown);
+
+			for (uint8_t i = 0; i < channel_count; ++i) {
+				ds18b20_fresh[i] = false;
+				if (
+					ds18b20_recovery.isBusAllowed(i)
+					&& (ds18b20_present[i] || probe)
+					&& !ds18b20[i].isBusy()
+					&& !ds18b20[i].start()
+					&& ds18b20_present[i]
+				) {
+					onDs18b20Error(i);
+					recordRead(DS18B20_A + i, true, false, 0);
+					ds18b20_round_pending = true;
+				}
+			}
+			ds18b20_next_update_timestamp = millis() + 2000U;
+		}
+
+		for (uint8_t i = 0; i < channel_count; ++i) {
+			const Ds18b20::Result result = ds18b20[i].run();
+
+			switch (result) {
+				case Ds18b20::Result::NONE: {
+					break;
+				}
+
+				case Ds18b20::Result::OK: {
+					ds18b20_consecutive_errors[i] = 0;
+					ds18b20_present[i] = true;
+					ds18b20_fresh[i] = true;
+					ds18b20_recovery.onSuccess(i);
+					break;
+				}
+
+				case Ds18b20::Result::CRC_ERROR:
+				case Ds18b20::Result::NO_RESPONSE: {
+					onDs18b20Error(i);
+					break;
+				}
+			}
+
+			if (result != Ds18b20::Result::NONE) {
+				if (ds18b20_present[i]) {
+					recordRead(
+						DS18B20_A + i,
+						result == Ds18b20::Result::NO_RESPONSE,
+						result == Ds18b20::Result::CRC_ERROR,
+						ds18b20[i].getReadMicros()
+					);
+				}
+				ds18b20_round_pending = true;
+			}
+		}
+
+		if (ds18b20_round_pending && !ds18b20[0].isBusy() && !ds18b20[1].isBusy()) {
+			ds18b20_round_pending = false;
+
+			if (isDs18b20Fresh(0) && isDs18b20Fresh(1)) {
+				floor_temperature_10th_c = floor_temperature_filter.add(vote(ds18b20[0].getTemperature10thC(), ds18b20[1].getTemperature10thC(), floor_temperature_10th_c, 10));
+				floor_value_read = true;
+			}
+			else if (isDs18b20Fresh(0) || isDs18b20Fresh(1)) {
+				floor_temperature_10th_c = floor_temperature_filter.add(ds18b20[isDs18b20Fresh(0) ? 0 : 1].getTemperature10thC());
+				floor_value_read = true;
+			}
+			else if (!isFloorValueValid()) {
+				floor_temperature_filter.reset();
+			}
+
+			updateFloorResolution();
+
+			const uint8_t cycled = ds18b20_recovery.startCycle();
+			countPowerCycles(DS18B20_A, cycled);
+
+			if (cycled) {
+				// Search the addresses again once powered up
+				for (uint8_t i = 0; i < channel_count; ++i) {
+					ds18b20[i].forgetAddress();
+				}
+			}
+		}
+	}
+
+	void recordRead(uint8_t sensor, bool timeout, bool checksum_error, uint16_t read_micros)
+	{
+		Health& h = health[sensor];
+
+		saturatingIncrement(h.reads);
+
+		if (timeout) {
+			saturatingIncrement(h.timeouts);
+			return;
+		}
+
+		if (checksum_error) {
+			saturatingIncrement(h.checksum_errors);
+		}
+
+		if (!timed_reads[sensor]) {
+			h.min_read_micros = read_micros;
+			h.max_read_micros = read_micros;
+		} else {
+			h.min_read_micros = min(h.min_read_micros, read_micros);
+			h.max_read_micros = max(h.max_read_micros, read_micros);
+		}
+
+		// The average freezes once the sum would overflow
+		if (total_read_micros[sensor] <= UINT32_MAX - read_micros) {
+			total_read_micros[sensor] += read_micros;
+			++timed_reads[sensor];
+		}
+	}
+
+	static bool isProbeRound(uint8_t& countdown)
+	{
+		if (countdown) {
+			--countdown;
+			return false;
+		}
+
+		countdown = absent_probe_rounds - 1;
+
+		return true;
+	}
+
+	// Convert coarse and fast while far from the thresholds, fine near them
+	void updateFloorResolution()
+	{
+		const int32_t distance = min(
+			abs(static_cast<int32_t>(floor_temperature_10th_c) - min_floor_temperature_10th_c),
+			abs(static_cast<int32_t>(floor_temperature_10th_c) - max_floor_temperature_10th_c)
+		);
 
-	OneWire one_wire;
-	DallasTemperature temperature_sensors;
-	int16_t ds18b20_last_value;
-	uint16_t ds18b20_consecutive_errors;
+		if (distance >= 30) {
+			floor_resolution = 9;
+		}
+		else if (distance >= 15) {
+			floor_resolution = 10;
+		}
+		else if (distance >= 5) {
+			floor_resolution = 11;
+		}
+		else {
+			floor_resolution = 12;
+		}
+
+		for (uint8_t i = 0; i < channel_count; ++i) {
+			ds18b20[i].setResolution(floor_resolution);
+		}
+	}
+
+	void onDht22Error(uint8_t index)
+	{
+		onError(dht22_consecutive_errors[index]);
+		if (needsRecovery(dht22_consecutive_errors[index], dht22_present[index])) {
+			dht22_recovery.onFailure(index);
+		}
+	}
+
+	void onDs18b20Error(uint8_t index)
+	{
+		onError(ds18b20_consecutive_errors[index]);
+		if (needsRecovery(ds18b20_consecutive_errors[index], ds18b20_present[index])) {
+			ds18b20_recovery.onFailure(index);
+		}
+	}
+
+	void countPowerCycles(uint8_t first_sensor, uint8_t channels)
+	{
+		for (uint8_t i = 0; i < channel_count; ++i) {
+			if (channels & 1U << i) {
+				saturatingIncrement(health[first_sensor + i].power_cycles);
+			}
+		}
+	}
+
+	static void onError(uint16_t& consecutive_errors)
+	{
+		++consecutive_errors;
+
+		if (!consecutive_errors) {
+			++consecutive_errors;
+		}
+	}
+
+	// Sensors of a kind share one supply line, which is power cycled
+	// when a present sensor failed five times in a row
+	static bool needsRecovery(uint16_t consecutive_errors, bool present)
+	{
+		return present && consecutive_errors >= 5;
+	}
+
+	Dht22 dht22[channel_count];
+	uint32_t dht22_next_update_timestamp;
+	uint16_t dht22_consecutive_errors[channel_count];
+	bool dht22_present[channel_count];
+	bool dht22_round_pending;
+	bool dht22_fresh[channel_count];
+	int16_t temperature_10th_c;
+	int16_t humidity_per_mill;
+	bool room_values_read;
+	Filter temperature_filter;
+	Filter humidity_filter;
+	bool outdoor_probe;
+	int16_t outdoor_temperature_10th_c;
+	int16_t outdoor_humidity_per_mill;
+	Filter outdoor_temperature_filter;
+	Filter outdoor_humidity_filter;
+
+	Ds18b20 ds18b20[channel_count];
+	uint32_t ds18b20_next_update_timestamp;
+	uint16_t ds18b20_consecutive_errors[channel_count];
+	bool ds18b20_present[channel_count];
+	bool ds18b20_round_pending;
+	bool ds18b20_fresh[channel_count];
+	int16_t floor_temperature_10th_c;
+	bool floor_value_read;
+	Filter floor_temperature_filter;
+	uint8_t floor_resolution;
+
+	int16_t min_floor_temperature_10th_c;
+	int16_t max_floor_temperature_10th_c;
+
+	Recovery dht22_recovery;
+	Recovery ds18b20_recovery;
+
+	Health health[SENSOR_COUNT];
+	uint32_t total_read_micros[SENSOR_COUNT];
+	uint32_t timed_reads[SENSOR_COUNT];
+
+	uint8_t dht22_probe_countdown;
+	uint8_t ds18b20_probe_countdown;
 };
 
 Sensors::Sensors() :
@@ -148,11 +809,21 @@ void Sensors::begin()
 	implementation->begin();
 }
 
+void Sensors::run()
+{
+	implementation->run();
+}
+
 bool Sensors::areRoomValuesValid() const
 {
 	return implementation->areRoomValuesValid();
 }
 
+bool Sensors::areRoomValuesRead() const
+{
+	return implementation->areRoomValuesRead();
+}
+
 int16_t Sensors::getTemperature10thC() const
 {
 	return implementation->getTemperature10thC();
@@ -168,7 +839,62 @@ bool Sensors::isFloorValueValid() const
 	return implementation->isFloorValueValid();
 }
 
+bool Sensors::isFloorValueRead() const
+{
+	return implementation->isFloorValueRead();
+}
+
 int16_t Sensors::getFloorTemperature10thC() const
 {
 	return implementation->getFloorTemperature10thC();
 }
+
+uint8_t Sensors::getFloorResolution() const
+{
+	return implementation->getFloorResolution();
+}
+
+uint8_t Sensors::getActiveFloorResolution() const
+{
+	return implementation->getActiveFloorResolution();
+}
+
+bool Sensors::isOutdoorValueValid() const
+{
+	return implementation->isOutdoorValueValid();
+}
+
+int16_t Sensors::getOutdoorTemperature10thC() const
+{
+	return implementation->getOutdoorTemperature10thC();
+}
+
+int16_t Sensors::getOutdoorHumidityPerMill() const
+{
+	return implementation->getOutdoorHumidityPerMill();
+}
+
+void Sensors::setFloorThresholds(int16_t min_10th_c, int16_t max_10th_c)
+{
+	implementation->setFloorThresholds(min_10th_c, max_10th_c);
+}
+
+void Sensors::setOutdoorProbe(bool enabled)
+{
+	implementation->setOutdoorProbe(enabled);
+}
+
+void Sensors::setFilter(uint8_t median_length, uint8_t ewma_shift)
+{
+	implementation->setFilter(median_length, ewma_shift);
+}
+
+Sensors::Health Sensors::getHealth(uint8_t sensor) const
+{
+	return implementation->getHealth(sensor);
+}
+
+void Sensors::dump() const
+{
+	implementation->dump();
+}
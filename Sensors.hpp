@@ -25,17 +25,62 @@
 class Sensors final
 {
 public:
+	static constexpr uint8_t max_filter_median_length = 5;
+	static constexpr uint8_t max_filter_ewma_shift = 4;
+
+	enum Sensor : uint8_t {
+		DHT22_A,
+		DHT22_B,
+		DS18B20_A,
+		DS18B20_B,
+		SENSOR_COUNT
+	};
+
+	struct Health {
+		uint32_t reads;
+		uint16_t checksum_errors;
+		uint16_t timeouts;
+		uint16_t power_cycles;
+		uint16_t min_read_micros;
+		uint16_t avg_read_micros;
+		uint16_t max_read_micros;
+	};
+
 	Sensors();
 	~Sensors();
 
 	void begin();
 
+	void run();
+
+	// Valid holds from the start for a present sensor, read only once
+	// a reading made it into the values
 	bool areRoomValuesValid() const;
+	bool areRoomValuesRead() const;
 	int16_t getTemperature10thC() const;
 	int16_t getHumidityPerMill() const;
 
 	bool isFloorValueValid() const;
+	bool isFloorValueRead() const;
 	int16_t getFloorTemperature10thC() const;
+	// Requested for the floor thresholds, and as read back from the sensor
+	uint8_t getFloorResolution() const;
+	uint8_t getActiveFloorResolution() const;
+
+	bool isOutdoorValueValid() const;
+	int16_t getOutdoorTemperature10thC() const;
+	int16_t getOutdoorHumidityPerMill() const;
+
+	void setFloorThresholds(int16_t min_10th_c, int16_t max_10th_c);
+
+	// Use DHT22 B as an outdoor probe instead of a redundant room sensor
+	void setOutdoorProbe(bool enabled);
+
+	void setFilter(uint8_t median_length, uint8_t ewma_shift);
+
+	Health getHealth(uint8_t sensor) const;
+
+	void dump() const;
 
 private:
 	class Implementation;
@@ -19,21 +19,14 @@
 */
 
 #include <Arduino.h>
-
 #include "Stats.hpp"
 
 #include "Controller.hpp"
+#include "Crc.hpp"
 
 namespace
 {
 
-	constexpr uint32_t period_ms = 5000;
-
-	constexpr bool timeAfter(uint32_t a, uint32_t b)
-	{
-		return static_cast<int32_t>(b - a) < 0;
-	}
-
 	void printTemperature(int16_t temperature_10th_c)
 	{
 		Serial.print(temperature_10th_c / 10);
@@ -73,6 +66,43 @@ namespace
 		Serial.println();
 	}
 
+	// Survives all resets but power-on, see Crc.hpp
+	struct Counters {
+		uint32_t seconds_since_reset;
+
+		int16_t min_room_temperature_10th_c;
+		int16_t max_room_temperature_10th_c;
+
+		int16_t min_floor_temperature_10th_c;
+		int16_t max_floor_temperature_10th_c;
+
+		int16_t min_humidity_per_mill;
+		int16_t max_humidity_per_mill;
+
+		int16_t min_outdoor_temperature_10th_c;
+		int16_t max_outdoor_temperature_10th_c;
+
+		int16_t min_outdoor_humidity_per_mill;
+		int16_t max_outdoor_humidity_per_mill;
+
+		bool prev_heating[Controller::ZONE_COUNT];
+		uint16_t heating_count[Controller::ZONE_COUNT];
+		uint32_t heating_seconds[Controller::ZONE_COUNT];
+
+		bool prev_shed[Controller::ZONE_COUNT];
+		uint16_t shed_count[Controller::ZONE_COUNT];
+		uint32_t shed_seconds[Controller::ZONE_COUNT];
+
+		bool prev_fan;
+		uint16_t fan_count;
+		uint32_t fan_low_seconds;
+		uint32_t fan_high_seconds;
+
+		uint16_t crc;
+	};
+
+	Counters counters __attribute__((section(".noinit")));
+
 }
 
 class Stats::Implementation final
@@ -85,62 +115,85 @@ public:
 
 	void begin()
 	{
-		reset();
+		if (
+			!controller.isWarmRestart()
+			|| counters.crc != Crc::get(&counters, offsetof(Counters, crc))
+		) {
+			reset();
+		}
 	}
 
-	void run()
+	void update()
 	{
-		const uint32_t now = millis();
+		constexpr uint32_t seconds = Stats::period_ms / 1000UL;
 
-		if (timeAfter(now, next_update_timestamp)) {
-			constexpr uint32_t seconds = period_ms / 1000UL;
+		counters.seconds_since_reset += seconds;
 
-			next_update_timestamp += period_ms;
+		const Controller::State state = controller.getState();
 
-			seconds_since_reset += seconds;
+		if (state.room_values_valid) {
+			counters.min_room_temperature_10th_c = min(counters.min_room_temperature_10th_c, state.temperature_10th_c);
+			counters.max_room_temperature_10th_c = max(counters.max_room_temperature_10th_c, state.temperature_10th_c);
 
-			const Controller::State state = controller.getState();
+			counters.min_humidity_per_mill = min(counters.min_humidity_per_mill, state.humidity_per_mill);
+			counters.max_humidity_per_mill = max(counters.max_humidity_per_mill, state.humidity_per_mill);
+		}
 
-			if (state.room_values_valid) {
-				min_room_temperature_10th_c = min(min_room_temperature_10th_c, state.temperature_10th_c);
-				max_room_temperature_10th_c = max(max_room_temperature_10th_c, state.temperature_10th_c);
+		if (state.floor_value_valid) {
+			counters.min_floor_temperature_10th_c = min(counters.min_floor_temperature_10th_c, state.floor_temperature_10th_c);
+			counters.max_floor_temperature_10th_c = max(counters.max_floor_temperature_10th_c, state.floor_temperature_10th_c);
+		}
 
-				min_humidity_per_mill = min(min_humidity_per_mill, state.humidity_per_mill);
-				max_humidity_per_mill = max(max_humidity_per_mill, state.humidity_per_mill);
-			}
+		if (state.outdoor_values_valid) {
+			counters.min_outdoor_temperature_10th_c = min(counters.min_outdoor_temperature_10th_c, state.outdoor_temperature_10th_c);
+			counters.max_outdoor_temperature_10th_c = max(counters.max_outdoor_temperature_10th_c, state.outdoor_temperature_10th_c);
 
-			if (state.floor_value_valid) {
-				min_floor_temperature_10th_c = min(min_floor_temperature_10th_c, state.floor_temperature_10th_c);
-				max_floor_temperature_10th_c = max(max_floor_temperature_10th_c, state.floor_temperature_10th_c);
-			}
+			counters.min_outdoor_humidity_per_mill = min(counters.min_outdoor_humidity_per_mill, state.outdoor_humidity_per_mill);
+			counters.max_outdoor_humidity_per_mill = max(counters.max_outdoor_humidity_per_mill, state.outdoor_humidity_per_mill);
+		}
 
-			if (!prev_lounge_heating && state.heating_lounge) {
-				++lounge_heating_count;
-			}
-			prev_lounge_heating = state.heating_lounge;
-			if (state.heating_lounge) {
-				lounge_heating_seconds += seconds;
-			}
+		for (uint8_t zone = 0; zone < Controller::ZONE_COUNT; ++zone) {
+			const bool heating = state.output[zone] == Controller::Output::ON;
 
-			if (!prev_vestibule_heating && state.heating_vestibule) {
-				++vestibule_heating_count;
+			if (!counters.prev_heating[zone] && heating) {
+				++counters.heating_count[zone];
 			}
-			prev_vestibule_heating = state.heating_vestibule;
-			if (state.heating_vestibule) {
-				vestibule_heating_seconds += seconds;
+			counters.prev_heating[zone] = heating;
+			if (heating) {
+				counters.heating_seconds[zone] += seconds;
 			}
 
-			if (!prev_fan && state.fan_speed != Fan::Speed::OFF) {
-				++fan_count;
+			const bool shed = state.output[zone] == Controller::Output::SHED;
+
+			if (!counters.prev_shed[zone] && shed) {
+				++counters.shed_count[zone];
 			}
-			prev_fan = state.fan_speed != Fan::Speed::OFF;
-			if (state.fan_speed == Fan::Speed::LOW) {
-				fan_low_seconds += seconds;
+			counters.prev_shed[zone] = shed;
+			if (shed) {
+				counters.shed_seconds[zone] += seconds;
 			}
-			else if (state.fan_speed == Fan::Speed::HIGH) {
-				fan_high_seconds += seconds;
+		}
+
+		if (!counters.prev_fan && state.fan_speed != Fan::Speed::OFF) {
+			++counters.fan_count;
+		}
+		counters.prev_fan = state.fan_speed != Fan::Speed::OFF;
+		if (state.fan_speed != Fan::Speed::OFF) {
+			// A variable duty counts as the speed it is closer to
+			const Controller::Configuration& configuration = controller.getConfiguration();
+			const bool high =
+				state.fan_speed == Fan::Speed::VARIABLE
+					? state.fan_duty * 2 > configuration.fan_speed_low + configuration.fan_speed_high
+					: state.fan_speed == Fan::Speed::HIGH;
+
+			if (high) {
+				counters.fan_high_seconds += seconds;
+			} else {
+				counters.fan_low_seconds += seconds;
 			}
 		}
+
+		counters.crc = Crc::get(&counters, offsetof(Counters, crc));
 	}
 
 	void dump() const
@@ -148,168 +201,194 @@ public:
 		Serial.println(F("Statistics:"));
 
 		Serial.print(F("  Counting for: "));
-		printDuration(seconds_since_reset);
+		printDuration(counters.seconds_since_reset);
 
 		Serial.print(F("  Minimum temperature: "));
-		printTemperature(min_room_temperature_10th_c);
+		printTemperature(counters.min_room_temperature_10th_c);
 		Serial.print(F("  Maximum temperature: "));
-		printTemperature(max_room_temperature_10th_c);
+		printTemperature(counters.max_room_temperature_10th_c);
 
 		Serial.print(F("  Minimum humidity: "));
-		printHumidity(min_humidity_per_mill);
+		printHumidity(counters.min_humidity_per_mill);
 		Serial.print(F("  Maximum humidity: "));
-		printHumidity(max_humidity_per_mill);
+		printHumidity(counters.max_humidity_per_mill);
 
 		Serial.print(F("  Minimum floor temperature: "));
-		printTemperature(min_floor_temperature_10th_c);
+		printTemperature(counters.min_floor_temperature_10th_c);
 		Serial.print(F("  Maximum floor temperature: "));
-		printTemperature(max_floor_temperature_10th_c);
-
-		Serial.print(F("  Lounge heating count: "));
-		Serial.println(lounge_heating_count);
-		Serial.print(F("  Lounge heating duration: "));
-		printDuration(lounge_heating_seconds);
-
-		Serial.print(F("  Vestibule heating count: "));
-		Serial.println(vestibule_heating_count);
-		Serial.print(F("  Vestibule heating duration: "));
-		printDuration(vestibule_heating_seconds);
+		printTemperature(counters.max_floor_temperature_10th_c);
+
+		Serial.print(F("  Minimum outdoor temperature: "));
+		printTemperature(counters.min_outdoor_temperature_10th_c);
+		Serial.print(F("  Maximum outdoor temperature: "));
+		printTemperature(counters.max_outdoor_temperature_10th_c);
+
+		Serial.print(F("  Minimum outdoor humidity: "));
+		printHumidity(counters.min_outdoor_humidity_per_mill);
+		Serial.print(F("  Maximum outdoor humidity: "));
+		printHumidity(counters.max_outdoor_humidity_per_mill);
+
+		for (uint8_t zone = 0; zone < Controller::ZONE_COUNT; ++zone) {
+			Serial.print(F("  "));
+			Serial.print(Controller::getZoneName(zone));
+			Serial.print(F(" heating count: "));
+			Serial.println(counters.heating_count[zone]);
+			Serial.print(F("  "));
+			Serial.print(Controller::getZoneName(zone));
+			Serial.print(F(" heating duration: "));
+			printDuration(counters.heating_seconds[zone]);
+			Serial.print(F("  "));
+			Serial.print(Controller::getZoneName(zone));
+			Serial.print(F(" heating energy: "));
+			Serial.print(counters.heating_seconds[zone] * controller.getConfiguration().heater_watts[zone] / 3600UL);
+			Serial.println(F(" Wh"));
+			Serial.print(F("  "));
+			Serial.print(Controller::getZoneName(zone));
+			Serial.print(F(" shed count: "));
+			Serial.println(counters.shed_count[zone]);
+			Serial.print(F("  "));
+			Serial.print(Controller::getZoneName(zone));
+			Serial.print(F(" shed duration: "));
+			printDuration(counters.shed_seconds[zone]);
+		}
 
 		Serial.print(F("  Fan run count: "));
-		Serial.println(fan_count);
+		Serial.println(counters.fan_count);
 		Serial.print(F("  Fan LOW duration: "));
-		printDuration(fan_low_seconds);
+		printDuration(counters.fan_low_seconds);
 		Serial.print(F("  Fan HIGH duration: "));
-		printDuration(fan_high_seconds);
+		printDuration(counters.fan_high_seconds);
 	}
 
 	void reset()
 	{
-		next_update_timestamp = millis() + period_ms;
+		counters.seconds_since_reset = 0;
 
-		seconds_since_reset = 0;
+		counters.min_room_temperature_10th_c = INT16_MAX;
+		counters.max_room_temperature_10th_c = -INT16_MAX;
 
-		min_room_temperature_10th_c = INT16_MAX;
-		max_room_temperature_10th_c = -INT16_MAX;
+		counters.min_floor_temperature_10th_c = INT16_MAX;
+		counters.max_floor_temperature_10th_c = -INT16_MAX;
 
-		min_floor_temperature_10th_c = INT16_MAX;
-		max_floor_temperature_10th_c = -INT16_MAX;
+		counters.min_humidity_per_mill = INT16_MAX;
+		counters.max_humidity_per_mill = -INT16_MAX;
 
-		min_humidity_per_mill = INT16_MAX;
-		max_humidity_per_mill = -INT16_MAX;
+		counters.min_outdoor_temperature_10th_c = INT16_MAX;
+		counters.max_outdoor_temperature_10th_c = -INT16_MAX;
 
-		prev_lounge_heating = false;
-		lounge_heating_count = 0;
-		lounge_heating_seconds = 0;
+		counters.min_outdoor_humidity_per_mill = INT16_MAX;
+		counters.max_outdoor_humidity_per_mill = -INT16_MAX;
 
-		prev_vestibule_heating = false;
-		vestibule_heating_count = 0;
-		vestibule_heating_seconds = 0;
+		for (uint8_t zone = 0; zone < Controller::ZONE_COUNT; ++zone) {
+			counters.prev_heating[zone] = false;
+			counters.heating_count[zone] = 0;
+			counters.heating_seconds[zone] = 0;
+
+			counters.prev_shed[zone] = false;
+			counters.shed_count[zone] = 0;
+			counters.shed_seconds[zone] = 0;
+		}
 
-		prev_fan = false;
-		fan_count = 0;
-		fan_low_seconds = 0;
-		fan_high_seconds = 0;
+		counters.prev_fan = false;
+		counters.fan_count = 0;
+		counters.fan_low_seconds = 0;
+		counters.fan_high_seconds = 0;
+
+		counters.crc = Crc::get(&counters, offsetof(Counters, crc));
 	}
 
 	uint32_t getSecondsSinceReset() const
 	{
-		return seconds_since_reset;
+		return counters.seconds_since_reset;
 	}
 
 	int16_t getMinRoomTemperature10thC() const
 	{
-		return min_room_temperature_10th_c;
+		return counters.min_room_temperature_10th_c;
 	}
 
 	int16_t getMaxRoomTemperature10thC() const
 	{
-		return max_room_temperature_10th_c;
+		return counters.max_room_temperature_10th_c;
 	}
 
 	int16_t getMinFloorTemperature10thC() const
 	{
-		return min_floor_temperature_10th_c;
+		return counters.min_floor_temperature_10th_c;
 	}
 
 	int16_t getMaxFloorTemperature10thC() const
 	{
-		return max_floor_temperature_10th_c;
+		return counters.max_floor_temperature_10th_c;
 	}
 
 	int16_t getMinHumidityPerMill() const
 	{
-		return min_humidity_per_mill;
+		return counters.min_humidity_per_mill;
 	}
 
 	int16_t getMaxHumidityPerMill() const
 	{
-		return max_humidity_per_mill;
+		return counters.max_humidity_per_mill;
 	}
 
-	uint16_t getLoungeHeatingCount() const
+	int16_t getMinOutdoorTemperature10thC() const
 	{
-		return lounge_heating_count;
+		return counters.min_outdoor_temperature_10th_c;
 	}
 
-	uint32_t getLoungeHeatingSeconds() const
+	int16_t getMaxOutdoorTemperature10thC() const
 	{
-		return lounge_heating_seconds;
+		return counters.max_outdoor_temperature_10th_c;
 	}
 
-	uint16_t getVestibuleHeatingCount() const
+	int16_t getMinOutdoorHumidityPerMill() const
 	{
-		return vestibule_heating_count;
+		return counters.min_outdoor_humidity_per_mill;
 	}
 
-	uint32_t getVestibuleHeatingSeconds() const
+	int16_t getMaxOutdoorHumidityPerMill() const
 	{
-		return vestibule_heating_seconds;
+		return counters.max_outdoor_humidity_per_mill;
+	}
+
+	uint16_t getHeatingCount(uint8_t zone) const
+	{
+		return counters.heating_count[zone];
+	}
+
+	uint32_t getHeatingSeconds(uint8_t zone) const
+	{
+		return counters.heating_seconds[zone];
+	}
+
+	uint16_t getShedCount(uint8_t zone) const
+	{
+		return counters.shed_count[zone];
+	}
+
+	uint32_t getShedSeconds(uint8_t zone) const
+	{
+		return counters.shed_seconds[zone];
 	}
 
 	uint16_t getFanCount() const
 	{
-		return fan_count;
+		return counters.fan_count;
 	}
 
 	uint32_t getFanLowSeconds() const
 	{
-		return fan_low_seconds;
+		return counters.fan_low_seconds;
 	}
 
 	uint32_t getFanHighSeconds() const
 	{
-		return fan_high_seconds;
+		return counters.fan_high_seconds;
 	}
 
 private:
 	const Controller& controller;
-
-	uint32_t next_update_timestamp;
-
-	uint32_t seconds_since_reset;
-
-	int16_t min_room_temperature_10th_c;
-	int16_t max_room_temperature_10th_c;
-
-	int16_t min_floor_temperature_10th_c;
-	int16_t max_floor_temperature_10th_c;
-
-	int16_t min_humidity_per_mill;
-	int16_t max_humidity_per_mill;
-
-	bool prev_lounge_heating;
-	uint16_t lounge_heating_count;
-	uint32_t lounge_heating_seconds;
-
-	bool prev_vestibule_heating;
-	uint16_t vestibule_heating_count;
-	uint32_t vestibule_heating_seconds;
-
-	bool prev_fan;
-	uint16_t fan_count;
-	uint32_t fan_low_seconds;
-	uint32_t fan_high_seconds;
 };
 
 Stats::Stats(const Controller& _controller) :
@@ -327,9 +406,9 @@ void Stats::begin()
 	implementation->begin();
 }
 
-void Stats::run()
+void Stats::update()
 {
-	implementation->run();
+	implementation->update();
 }
 
 void Stats::dump() const
@@ -372,24 +451,44 @@ int16_t Stats::getMaxHumidityPerMill() const
 	return implementation->getMaxHumidityPerMill();
 }
 
-uint16_t Stats::getLoungeHeatingCount() const
+int16_t Stats::getMinOutdoorTemperature10thC() const
+{
+	return implementation->getMinOutdoorTemperature10thC();
+}
+
+int16_t Stats::getMaxOutdoorTemperature10thC() const
+{
+	return implementation->getMaxOutdoorTemperature10thC();
+}
+
+int16_t Stats::getMinOutdoorHumidityPerMill() const
+{
+	return implementation->getMinOutdoorHumidityPerMill();
+}
+
+int16_t Stats::getMaxOutdoorHumidityPerMill() const
+{
+	return implementation->getMaxOutdoorHumidityPerMill();
+}
+
+uint16_t Stats::getHeatingCount(uint8_t zone) const
 {
-	return implementation->getLoungeHeatingCount();
+	return implementation->getHeatingCount(zone);
 }
 
-uint32_t Stats::getLoungeHeatingSeconds() const
+uint32_t Stats::getHeatingSeconds(uint8_t zone) const
 {
-	return implementation->getLoungeHeatingSeconds();
+	return implementation->getHeatingSeconds(zone);
 }
 
-uint16_t Stats::getVestibuleHeatingCount() const
+uint16_t Stats::getShedCount(uint8_t zone) const
 {
-	return implementation->getVestibuleHeatingCount();
+	return implementation->getShedCount(zone);
 }
 
-uint32_t Stats::getVestibuleHeatingSeconds() const
+uint32_t Stats::getShedSeconds(uint8_t zone) const
 {
-	return implementation->getVestibuleHeatingSeconds();
+	return implementation->getShedSeconds(zone);
 }
 
 uint16_t Stats::getFanCount() const
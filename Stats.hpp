@@ -27,11 +27,14 @@ class Controller;
 class Stats final
 {
 public:
+	static constexpr uint32_t period_ms = 5000;
+
 	Stats(const Controller& _controller);
 
 	void begin();
 
-	void run();
+	// Call every period_ms
+	void update();
 
 	void dump() const;
 
@@ -48,11 +51,17 @@ public:
 	int16_t getMinHumidityPerMill() const;
 	int16_t getMaxHumidityPerMill() const;
 
-	uint16_t getLoungeHeatingCount() const;
-	uint32_t getLoungeHeatingSeconds() const;
+	int16_t getMinOutdoorTemperature10thC() const;
+	int16_t getMaxOutdoorTemperature10thC() const;
+
+	int16_t getMinOutdoorHumidityPerMill() const;
+	int16_t getMaxOutdoorHumidityPerMill() const;
+
+	uint16_t getHeatingCount(uint8_t zone) const;
+	uint32_t getHeatingSeconds(uint8_t zone) const;
 
-	uint16_t getVestibuleHeatingCount() const;
-	uint32_t getVestibuleHeatingSeconds() const;
+	uint16_t getShedCount(uint8_t zone) const;
+	uint32_t getShedSeconds(uint8_t zone) const;
 
 	uint16_t getFanCount() const;
 	uint32_t getFanLowSeconds() const;